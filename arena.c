@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdalign.h>
+#include "arena.h"
+#include "parson.h"
+
+// blocks and allocations start at multiples of this, so any type fits
+#define ARENA_ALIGNMENT alignof(max_align_t)
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+#define ARENA_HEADER_SIZE ARENA_ALIGN(sizeof(arena_block))
+
+// parson's allocation functions don't take a context, so the arena in use is global
+static arena *json_arena;
+
+void arena_init(arena *arena)
+{
+    arena->blocks = NULL;
+}
+
+void *arena_alloc(arena *arena, size_t size)
+{
+    arena_block *block = arena->blocks;
+
+    size = ARENA_ALIGN(size);
+
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = block != NULL ? 2 * block->size : ARENA_BLOCK_SIZE;
+
+        while (block_size < size)
+            block_size *= 2;
+
+        block = malloc(ARENA_HEADER_SIZE + block_size);
+        if (block == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        block->next = arena->blocks;
+        block->size = block_size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+
+    void *data = (char *) block + ARENA_HEADER_SIZE + block->used;
+    block->used += size;
+
+    return data;
+}
+
+void arena_destroy(arena *arena)
+{
+    while (arena->blocks != NULL) {
+        arena_block *next = arena->blocks->next;
+
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
+
+static void *json_arena_malloc(size_t size)
+{
+    return arena_alloc(json_arena, size);
+}
+
+// the memory goes back when the whole arena is destroyed
+static void json_arena_free(void *data)
+{
+    (void) data;
+}
+
+void json_arena_begin(arena *arena)
+{
+    json_arena = arena;
+    json_set_allocation_functions(json_arena_malloc, json_arena_free);
+}
+
+void json_arena_end(void)
+{
+    json_arena = NULL;
+    json_set_allocation_functions(malloc, free);
+}
@@ -0,0 +1,41 @@
+#ifndef _ARENA_
+#define _ARENA_
+
+#include <stddef.h>
+
+// size of the first block of an arena, every new block is twice the last
+#define ARENA_BLOCK_SIZE 65536
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+} arena_block;
+
+/* a bump-pointer allocator for short lived data, like the values of one
+ * parsed response, which is all released at once instead of piece by piece
+ */
+typedef struct {
+    arena_block *blocks;
+} arena;
+
+// initializes an empty arena
+void arena_init(arena *arena);
+
+// returns size bytes from the arena, aligned for any type
+void *arena_alloc(arena *arena, size_t size);
+
+// releases everything allocated from the arena, with one free() per block
+void arena_destroy(arena *arena);
+
+/* makes parson allocate from arena until json_arena_end, with freeing being
+ * a no-op, so that values parsed in between are released with the arena
+ * instead of json_value_free
+ * NOTE: nothing parson allocates in between may outlive the arena
+ */
+void json_arena_begin(arena *arena);
+
+// makes parson go back to malloc and free
+void json_arena_end(void);
+
+#endif
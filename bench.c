@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include "buffer.h"
+#include "parson.h"
+#include "arena.h"
+#include "jsonstream.h"
+
+#define BENCH_RESPONSE_SIZE (1 << 20)
+#define BENCH_ROUNDS 500
+#define BENCH_CHECKS 200000
+#define BENCH_BOOKS 50000
+#define BENCH_JSON_ROUNDS 20
+#define BENCH_FIRST_ID 9007199254740993LL
+
+// the byte by byte searches the vectorized ones have to agree with
+static int reference_search(buffer *buffer, const char *data, size_t data_size, int insensitive)
+{
+    if (data_size > buffer->size)
+        return -1;
+
+    size_t last_pos = buffer->size - data_size + 1;
+
+    for (size_t i = 0; i < last_pos; ++i) {
+        size_t j;
+
+        for (j = 0; j < data_size; ++j) {
+            if (insensitive ? tolower(buffer->data[i + j]) != tolower(data[j])
+                            : buffer->data[i + j] != data[j])
+                break;
+        }
+
+        if (j == data_size)
+            return i;
+    }
+
+    return -1;
+}
+
+// called through a volatile pointer so that repeated searches aren't folded into one
+static int (*volatile reference_find)(buffer *, const char *, size_t, int) = reference_search;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// compares the searches with the reference on small random buffers
+static int check(void)
+{
+    const char alphabet[] = "aAbBzZ@[\r\n\xc1";
+    char haystack[64], needle[8];
+
+    srand(4);
+
+    for (int i = 0; i < BENCH_CHECKS; i++) {
+        buffer sample = { haystack, rand() % sizeof(haystack) };
+        size_t needle_size = rand() % sizeof(needle);
+        size_t offset = rand() % (sample.size + 1);
+
+        for (size_t j = 0; j < sample.size; j++)
+            haystack[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+        for (size_t j = 0; j < needle_size; j++)
+            needle[j] = alphabet[rand() % (sizeof(alphabet) - 1)];
+
+        buffer tail = { haystack + offset, sample.size - offset };
+        int crlf = reference_find(&tail, "\r\n", 2, 0);
+
+        if (buffer_find(&sample, needle, needle_size) != reference_find(&sample, needle, needle_size, 0)
+            || buffer_find_insensitive(&sample, needle, needle_size) != reference_find(&sample, needle, needle_size, 1)
+            || buffer_find_crlf(&sample, offset) != (crlf < 0 ? -1 : (int)offset + crlf)) {
+            fprintf(stderr, "mismatch on check %d\n", i);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+// prints how many MB/s a search goes through when its needle is at the very end
+static void measure(const char *name, buffer *response, const char *needle, int insensitive)
+{
+    double start = now();
+    int found = 0;
+
+    for (int i = 0; i < BENCH_ROUNDS; i++)
+        found += reference_find(response, needle, strlen(needle), insensitive);
+
+    double reference = now() - start;
+
+    start = now();
+
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        found -= insensitive ? buffer_find_insensitive(response, needle, strlen(needle))
+                             : buffer_find(response, needle, strlen(needle));
+    }
+
+    double vectorized = now() - start;
+    double megabytes = (double)response->size * BENCH_ROUNDS / (1 << 20);
+
+    printf("%-18s byte by byte %6.0f MB/s, %-4s %6.0f MB/s%s\n", name, megabytes / reference,
+           buffer_simd(), megabytes / vectorized, found != 0 ? " (mismatch)" : "");
+}
+
+// compares the vectorized searches with byte by byte ones on a large response
+static int bench_search(void)
+{
+    const char header[] = "HTTP/1.1 200 OK\r\nX-Powered-By: Express\r\nContent-Type: application/json\r\n";
+    const char book[] = "{\"id\":12345,\"title\":\"The Hitchhiker's Guide to the Galaxy\"},";
+    buffer response = buffer_init();
+
+    if (check() < 0)
+        return -1;
+
+    // a large get_books answer whose header block only ends at the very end
+    buffer_add(&response, header, sizeof(header) - 1);
+
+    while (response.size < BENCH_RESPONSE_SIZE)
+        buffer_add(&response, book, sizeof(book) - 1);
+
+    buffer_add(&response, "\r\nContent-Length: 0\r\n\r\n", 23);
+
+    measure("header terminator", &response, "\r\n\r\n", 0);
+    measure("content-length", &response, "content-length: ", 1);
+
+    buffer_destroy(&response);
+
+    return 0;
+}
+
+// joins the keys and strings a stream reports, failing on one without a buffer
+static void stream_strings(void *context, int event, const char *data, size_t size)
+{
+    buffer *strings = context;
+
+    if (event != JSON_STREAM_KEY && event != JSON_STREAM_STRING)
+        return;
+
+    if (data == NULL || data[size] != '\0') {
+        buffer_add(strings, "!", 1);
+        return;
+    }
+
+    buffer_add(strings, data, size);
+    buffer_add(strings, "|", 1);
+}
+
+// checks that empty keys and strings still come to the callback as empty strings
+static int check_stream(void)
+{
+    const char body[] = "[{\"\":1,\"id\":3,\"title\":\"\"}]";
+    const char expected[] = "|id|title||";
+    buffer strings = buffer_init();
+    json_stream stream;
+
+    json_stream_init(&stream, stream_strings, &strings);
+
+    int result = json_stream_feed(&stream, body, sizeof(body) - 1) < 0
+                 || json_stream_finish(&stream) < 0
+                 || strings.size != sizeof(expected) - 1
+                 || memcmp(strings.data, expected, strings.size) != 0 ? -1 : 0;
+
+    if (result < 0)
+        fprintf(stderr, "stream mismatch on empty keys and strings\n");
+
+    json_stream_destroy(&stream);
+    buffer_destroy(&strings);
+
+    return result;
+}
+
+/* compares parsing and freeing a large get_books body with malloc, with an
+ * arena, and with an arena while parsing in place
+ */
+static int bench_json(void)
+{
+    char book[128];
+    buffer body = buffer_init();
+    char *scratch;
+
+    if (check_stream() < 0)
+        return -1;
+
+    buffer_add(&body, "[", 1);
+
+    for (int i = 0; i < BENCH_BOOKS; i++) {
+        int size = snprintf(book, sizeof(book), "%s{\"id\":%d,\"title\":\"Book number %d\"}",
+                            i > 0 ? "," : "", i, i);
+        buffer_add(&body, book, size);
+    }
+
+    // the terminator is added along with the closing bracket
+    buffer_add(&body, "]", 2);
+
+    double start = now();
+
+    for (int i = 0; i < BENCH_JSON_ROUNDS; i++) {
+        JSON_Value *value = json_parse_string(body.data);
+
+        if (json_array_get_count(json_value_get_array(value)) != BENCH_BOOKS)
+            return -1;
+
+        json_value_free(value);
+    }
+
+    double heap = now() - start;
+
+    start = now();
+
+    for (int i = 0; i < BENCH_JSON_ROUNDS; i++) {
+        arena values;
+
+        arena_init(&values);
+        json_arena_begin(&values);
+        JSON_Value *value = json_parse_string(body.data);
+        json_arena_end();
+
+        if (json_array_get_count(json_value_get_array(value)) != BENCH_BOOKS)
+            return -1;
+
+        arena_destroy(&values);
+    }
+
+    double pooled = now() - start;
+    double in_situ = 0;
+
+    scratch = malloc(body.size);
+    if (scratch == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // the body is written over, so each round parses a fresh copy made off the clock
+    for (int i = 0; i < BENCH_JSON_ROUNDS; i++) {
+        arena values;
+
+        memcpy(scratch, body.data, body.size);
+        start = now();
+
+        arena_init(&values);
+        json_arena_begin(&values);
+        JSON_Value *value = json_parse_string_in_situ(scratch);
+        json_arena_end();
+
+        if (json_array_get_count(json_value_get_array(value)) != BENCH_BOOKS)
+            return -1;
+
+        arena_destroy(&values);
+        in_situ += now() - start;
+    }
+
+    printf("parse and free %d books: malloc %.2f ms, arena %.2f ms, arena in situ %.2f ms\n",
+           BENCH_BOOKS, heap * 1000 / BENCH_JSON_ROUNDS, pooled * 1000 / BENCH_JSON_ROUNDS,
+           in_situ * 1000 / BENCH_JSON_ROUNDS);
+
+    free(scratch);
+    buffer_destroy(&body);
+
+    return 0;
+}
+
+// builds a listing of books whose ids are past 2^53, with fractional page counts if asked
+static void numbers_body(buffer *body, const char *page_suffix)
+{
+    char book[128];
+
+    buffer_add(body, "[", 1);
+
+    for (int i = 0; i < BENCH_BOOKS; i++) {
+        int size = snprintf(book, sizeof(book), "%s{\"id\":%lld,\"page_count\":%d%s}",
+                            i > 0 ? "," : "", BENCH_FIRST_ID + i, 100 + i, page_suffix);
+        buffer_add(body, book, size);
+    }
+
+    buffer_add(body, "]", 2);
+}
+
+// checks that floats too large for an integer are clamped when read as one
+static int check_integers(void)
+{
+    JSON_Value *value = json_parse_string("[1e300,-1e300,-2.5]");
+    JSON_Array *numbers = json_value_get_array(value);
+
+    int result = json_array_get_integer(numbers, 0) != INT64_MAX
+                 || json_array_get_integer(numbers, 1) != INT64_MIN
+                 || json_array_get_integer(numbers, 2) != -2 ? -1 : 0;
+
+    if (result < 0)
+        fprintf(stderr, "mismatch on integers out of range\n");
+
+    json_value_free(value);
+
+    return result;
+}
+
+/* compares parsing and serializing a number heavy listing with integers and
+ * with the same numbers as floats
+ */
+static int bench_numbers(void)
+{
+    buffer integers = buffer_init(), floats = buffer_init();
+    double parsed[2], serialized[2];
+    buffer *bodies[2] = { &integers, &floats };
+
+    if (check_integers() < 0)
+        return -1;
+
+    numbers_body(&integers, "");
+    numbers_body(&floats, ".5");
+
+    for (int kind = 0; kind < 2; kind++) {
+        JSON_Value *value = NULL;
+        double start = now();
+
+        for (int i = 0; i < BENCH_JSON_ROUNDS; i++) {
+            json_value_free(value);
+            value = json_parse_string(bodies[kind]->data);
+        }
+
+        parsed[kind] = now() - start;
+
+        // ids past 2^53 only survive as integers
+        JSON_Object *last = json_array_get_object(json_value_get_array(value), BENCH_BOOKS - 1);
+        if (kind == 0 && json_object_get_integer(last, "id") != BENCH_FIRST_ID + BENCH_BOOKS - 1)
+            return -1;
+
+        start = now();
+
+        for (int i = 0; i < BENCH_JSON_ROUNDS; i++) {
+            char *text = json_serialize_to_string(value);
+
+            if (kind == 0 && strcmp(text, bodies[kind]->data) != 0)
+                return -1;
+
+            json_free_serialized_string(text);
+        }
+
+        serialized[kind] = now() - start;
+        json_value_free(value);
+    }
+
+    printf("parse %d books of numbers: integers %.2f ms, floats %.2f ms\n",
+           BENCH_BOOKS, parsed[0] * 1000 / BENCH_JSON_ROUNDS, parsed[1] * 1000 / BENCH_JSON_ROUNDS);
+    printf("serialize %d books of numbers: integers %.2f ms, floats %.2f ms\n",
+           BENCH_BOOKS, serialized[0] * 1000 / BENCH_JSON_ROUNDS,
+           serialized[1] * 1000 / BENCH_JSON_ROUNDS);
+
+    buffer_destroy(&integers);
+    buffer_destroy(&floats);
+
+    return 0;
+}
+
+// runs the benchmark named on the command line, or all of them
+int main(int argc, char **argv)
+{
+    const char *name = argc > 1 ? argv[1] : NULL;
+
+    if ((name == NULL || strcmp(name, "search") == 0) && bench_search() < 0)
+        return EXIT_FAILURE;
+
+    if ((name == NULL || strcmp(name, "json") == 0) && bench_json() < 0)
+        return EXIT_FAILURE;
+
+    if ((name == NULL || strcmp(name, "numbers") == 0) && bench_numbers() < 0)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
@@ -1,5 +1,19 @@
+#include <pthread.h>
 #include "buffer.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BUFFER_X86
+#endif
+
+// looks for needle in haystack and returns its position, -1 if it isn't there
+typedef int (*search_function)(const char *haystack, size_t size,
+                               const char *needle, size_t needle_size, int insensitive);
+
+static search_function search;
+static const char *search_name;
+static pthread_once_t search_once = PTHREAD_ONCE_INIT;
+
 buffer buffer_init(void)
 {
     buffer buffer;
@@ -38,48 +52,248 @@ void buffer_add(buffer *buffer, const char *data, size_t data_size)
     buffer->size += data_size;
 }
 
-int buffer_find(buffer *buffer, const char *data, size_t data_size)
+// checks if the needle_size bytes at position match needle
+static int search_matches(const char *position, const char *needle, size_t needle_size, int insensitive)
 {
-    if (data_size > buffer->size)
-        return -1;
+    if (!insensitive)
+        return memcmp(position, needle, needle_size) == 0;
 
-    size_t last_pos = buffer->size - data_size + 1;
+    for (size_t i = 0; i < needle_size; ++i) {
+        if (tolower(position[i]) != tolower(needle[i]))
+            return 0;
+    }
 
-    for (size_t i = 0; i < last_pos; ++i) {
-        size_t j;
+    return 1;
+}
 
-        for (j = 0; j < data_size; ++j) {
-            if (buffer->data[i + j] != data[j]) {
-                break;
-            }
-        }
+/* every search is written once for both kinds of comparison; its callers pass
+ * a constant insensitive, so each of them gets its own loop without the checks
+ */
+#define SEARCH_INLINE static inline __attribute__((always_inline))
+
+SEARCH_INLINE int search_scalar_loop(const char *haystack, size_t size,
+                                     const char *needle, size_t needle_size, int insensitive)
+{
+    size_t last_pos = size - needle_size + 1;
+    char first = insensitive ? tolower(needle[0]) : needle[0];
+
+    for (size_t i = 0; i < last_pos; ++i) {
+        char c = insensitive ? tolower(haystack[i]) : haystack[i];
 
-        if (j == data_size)
+        if (c == first && search_matches(haystack + i, needle, needle_size, insensitive))
             return i;
     }
 
     return -1;
 }
 
-int buffer_find_insensitive(buffer *buffer, const char *data, size_t data_size)
+static int search_scalar(const char *haystack, size_t size,
+                         const char *needle, size_t needle_size, int insensitive)
 {
-    if (data_size > buffer->size)
-        return -1;
+    if (insensitive)
+        return search_scalar_loop(haystack, size, needle, needle_size, 1);
+
+    return search_scalar_loop(haystack, size, needle, needle_size, 0);
+}
 
-    size_t last_pos = buffer->size - data_size + 1;
+#ifdef BUFFER_X86
 
-    for (size_t i = 0; i < last_pos; ++i) {
-        size_t j;
+/* the vector searches compare the first and the last byte of the needle with
+ * a whole block of candidate positions at once and only check the rest of the
+ * needle where both of them match; the positions left after the last full
+ * block are checked by search_scalar
+ */
+
+// lowercases the ASCII letters in a vector, like tolower() in the C locale
+__attribute__((target("sse2")))
+static __m128i lower_sse2(__m128i bytes)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), bytes));
+
+    return _mm_or_si128(bytes, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse2")))
+SEARCH_INLINE int search_sse2_loop(const char *haystack, size_t size,
+                                 const char *needle, size_t needle_size, int insensitive)
+{
+    size_t last_pos = size - needle_size + 1;
+    char first_byte = insensitive ? tolower(needle[0]) : needle[0];
+    char last_byte = insensitive ? tolower(needle[needle_size - 1]) : needle[needle_size - 1];
+    __m128i first = _mm_set1_epi8(first_byte);
+    __m128i last = _mm_set1_epi8(last_byte);
+    size_t i;
+
+    for (i = 0; i + 16 <= last_pos; i += 16) {
+        __m128i starts = _mm_loadu_si128((const __m128i *)(haystack + i));
+        __m128i ends = _mm_loadu_si128((const __m128i *)(haystack + i + needle_size - 1));
 
-        for (j = 0; j < data_size; ++j) {
-            if (tolower(buffer->data[i + j]) != tolower(data[j])) {
-                break;
-            }
+        if (insensitive) {
+            starts = lower_sse2(starts);
+            ends = lower_sse2(ends);
         }
 
-        if (j == data_size)
-            return i;
+        unsigned int mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(starts, first),
+                                                            _mm_cmpeq_epi8(ends, last)));
+
+        while (mask != 0) {
+            size_t position = i + __builtin_ctz(mask);
+
+            if (search_matches(haystack + position, needle, needle_size, insensitive))
+                return position;
+
+            mask &= mask - 1;
+        }
     }
 
-    return -1;
+    int found = search_scalar(haystack + i, size - i, needle, needle_size, insensitive);
+
+    return found < 0 ? -1 : (int)i + found;
+}
+
+__attribute__((target("sse2")))
+static int search_sse2(const char *haystack, size_t size,
+                       const char *needle, size_t needle_size, int insensitive)
+{
+    if (insensitive)
+        return search_sse2_loop(haystack, size, needle, needle_size, 1);
+
+    return search_sse2_loop(haystack, size, needle, needle_size, 0);
+}
+
+__attribute__((target("avx2")))
+static __m256i lower_avx2(__m256i bytes)
+{
+    __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8('A' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), bytes));
+
+    return _mm256_or_si256(bytes, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+SEARCH_INLINE int search_avx2_loop(const char *haystack, size_t size,
+                                 const char *needle, size_t needle_size, int insensitive)
+{
+    size_t last_pos = size - needle_size + 1;
+    char first_byte = insensitive ? tolower(needle[0]) : needle[0];
+    char last_byte = insensitive ? tolower(needle[needle_size - 1]) : needle[needle_size - 1];
+    __m256i first = _mm256_set1_epi8(first_byte);
+    __m256i last = _mm256_set1_epi8(last_byte);
+    size_t i;
+
+    for (i = 0; i + 32 <= last_pos; i += 32) {
+        __m256i starts = _mm256_loadu_si256((const __m256i *)(haystack + i));
+        __m256i ends = _mm256_loadu_si256((const __m256i *)(haystack + i + needle_size - 1));
+
+        if (insensitive) {
+            starts = lower_avx2(starts);
+            ends = lower_avx2(ends);
+        }
+
+        unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(starts, first),
+                                                                  _mm256_cmpeq_epi8(ends, last)));
+
+        while (mask != 0) {
+            size_t position = i + __builtin_ctz(mask);
+
+            if (search_matches(haystack + position, needle, needle_size, insensitive))
+                return position;
+
+            mask &= mask - 1;
+        }
+    }
+
+    int found = search_scalar(haystack + i, size - i, needle, needle_size, insensitive);
+
+    return found < 0 ? -1 : (int)i + found;
+}
+
+__attribute__((target("avx2")))
+static int search_avx2(const char *haystack, size_t size,
+                       const char *needle, size_t needle_size, int insensitive)
+{
+    if (insensitive)
+        return search_avx2_loop(haystack, size, needle, needle_size, 1);
+
+    return search_avx2_loop(haystack, size, needle, needle_size, 0);
+}
+
+#endif
+
+// picks the widest search the CPU supports, within the limit set in the environment
+static void search_select(void)
+{
+    char *limit = getenv(BUFFER_SIMD_ENV);
+
+    search = search_scalar;
+    search_name = "none";
+
+#ifdef BUFFER_X86
+    if (limit != NULL && strcmp(limit, "none") == 0)
+        return;
+
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("sse2")) {
+        search = search_sse2;
+        search_name = "sse2";
+    }
+
+    if ((limit == NULL || strcmp(limit, "sse2") != 0) && __builtin_cpu_supports("avx2")) {
+        search = search_avx2;
+        search_name = "avx2";
+    }
+#else
+    (void)limit;
+#endif
+}
+
+// searches the buffer from offset on, with the same results as a byte by byte search
+static int buffer_search(buffer *buffer, size_t offset, const char *data, size_t data_size, int insensitive)
+{
+    if (offset > buffer->size || data_size > buffer->size - offset)
+        return -1;
+
+    if (data_size == 0)
+        return offset;
+
+    pthread_once(&search_once, search_select);
+
+    int found = search(buffer->data + offset, buffer->size - offset, data, data_size, insensitive);
+
+    return found < 0 ? -1 : (int)offset + found;
+}
+
+int buffer_find(buffer *buffer, const char *data, size_t data_size)
+{
+    return buffer_search(buffer, 0, data, data_size, 0);
+}
+
+int buffer_find_insensitive(buffer *buffer, const char *data, size_t data_size)
+{
+    return buffer_search(buffer, 0, data, data_size, 1);
+}
+
+int buffer_find_newline(buffer *buffer, size_t offset)
+{
+    if (offset >= buffer->size)
+        return -1;
+
+    // memchr is already vectorized by the C library
+    char *newline = memchr(buffer->data + offset, '\n', buffer->size - offset);
+
+    return newline == NULL ? -1 : newline - buffer->data;
+}
+
+int buffer_find_crlf(buffer *buffer, size_t offset)
+{
+    return buffer_search(buffer, offset, "\r\n", 2, 0);
+}
+
+const char *buffer_simd(void)
+{
+    pthread_once(&search_once, search_select);
+
+    return search_name;
 }
@@ -1,8 +1,14 @@
+#ifndef _BUFFER_
+#define _BUFFER_
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+// set to "none", "sse2" or "avx2" to limit the instructions searches use
+#define BUFFER_SIMD_ENV "BUFFER_SIMD"
+
 typedef struct {
     char *data;
     size_t size;
@@ -25,4 +31,17 @@ int buffer_find(buffer *buffer, const char *data, size_t data_size);
 
 // finds data of size data_size in a buffer in a
 // case-insensitive fashion and returns its position
-int buffer_find_insensitive(buffer *buffer, const char *data, size_t data_size);
\ No newline at end of file
+int buffer_find_insensitive(buffer *buffer, const char *data, size_t data_size);
+
+// finds the first line feed at or after offset in a buffer and returns its position
+int buffer_find_newline(buffer *buffer, size_t offset);
+
+// finds the first "\r\n" at or after offset in a buffer and returns its position
+int buffer_find_crlf(buffer *buffer, size_t offset);
+
+/* returns the name of the instructions used by the searches above, which are
+ * picked once, from what the CPU supports
+ */
+const char *buffer_simd(void);
+
+#endif
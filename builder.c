@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "builder.h"
+
+void builder_init(builder *builder, size_t capacity)
+{
+    // one more byte always stays free for the terminator
+    builder->data = malloc(capacity + 1);
+    if (builder->data == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    builder->data[0] = '\0';
+    builder->size = 0;
+    builder->capacity = capacity;
+}
+
+void builder_reserve(builder *builder, size_t size)
+{
+    if (builder->capacity - builder->size >= size)
+        return;
+
+    size_t capacity = 2 * builder->capacity;
+
+    if (capacity < builder->size + size)
+        capacity = builder->size + size;
+
+    builder->data = realloc(builder->data, capacity + 1);
+    if (builder->data == NULL) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+
+    builder->capacity = capacity;
+}
+
+void builder_add(builder *builder, const char *data, size_t data_size)
+{
+    builder_reserve(builder, data_size);
+
+    memcpy(builder->data + builder->size, data, data_size);
+    builder->size += data_size;
+    builder->data[builder->size] = '\0';
+}
+
+void builder_add_string(builder *builder, const char *string)
+{
+    builder_add(builder, string, strlen(string));
+}
+
+size_t builder_size_digits(size_t number)
+{
+    size_t digits = 1;
+
+    while (number >= 10) {
+        number /= 10;
+        digits++;
+    }
+
+    return digits;
+}
+
+void builder_add_size(builder *builder, size_t number)
+{
+    size_t digits = builder_size_digits(number);
+
+    builder_reserve(builder, digits);
+
+    // the digits are written from the last one
+    for (size_t i = digits; i > 0; i--) {
+        builder->data[builder->size + i - 1] = '0' + number % 10;
+        number /= 10;
+    }
+
+    builder->size += digits;
+    builder->data[builder->size] = '\0';
+}
+
+size_t builder_header_size(const char *name, const char *value)
+{
+    return strlen(name) + 2 + strlen(value) + 2;
+}
+
+void builder_add_header(builder *builder, const char *name, const char *value)
+{
+    builder_add_string(builder, name);
+    builder_add(builder, ": ", 2);
+    builder_add_string(builder, value);
+    builder_add(builder, "\r\n", 2);
+}
+
+char *builder_release(builder *builder)
+{
+    char *data = builder->data;
+
+    builder->data = NULL;
+    builder->size = 0;
+    builder->capacity = 0;
+
+    return data;
+}
+
+void builder_destroy(builder *builder)
+{
+    free(builder_release(builder));
+}
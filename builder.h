@@ -0,0 +1,47 @@
+#ifndef _BUILDER_
+#define _BUILDER_
+
+#include <stddef.h>
+
+/* a NUL-terminated string built by appending to it, whose allocation grows
+ * geometrically so that every append takes amortized constant time
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} builder;
+
+// initializes a builder with room for capacity bytes, allocated at once
+void builder_init(builder *builder, size_t capacity);
+
+// makes room for size more bytes, growing the allocation at least twofold if needed
+void builder_reserve(builder *builder, size_t size);
+
+// appends data of size data_size to a builder
+void builder_add(builder *builder, const char *data, size_t data_size);
+
+// appends a NUL-terminated string to a builder
+void builder_add_string(builder *builder, const char *string);
+
+// appends the decimal digits of number to a builder
+void builder_add_size(builder *builder, size_t number);
+
+// appends a "name: value" header line, with its "\r\n", to a builder
+void builder_add_header(builder *builder, const char *name, const char *value);
+
+// returns how many bytes builder_add_header adds for name and value
+size_t builder_header_size(const char *name, const char *value);
+
+// returns how many decimal digits number has
+size_t builder_size_digits(size_t number);
+
+/* returns the built string and leaves the builder empty
+ * NOTE: the caller is responsible for freeing it
+ */
+char *builder_release(builder *builder);
+
+// frees the string of a builder
+void builder_destroy(builder *builder);
+
+#endif
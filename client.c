@@ -2,46 +2,146 @@
 #include <stdlib.h>     /* exit, atoi, malloc, free */
 #include <unistd.h>     /* read, write, close */
 #include <string.h>     /* memcpy, memset */
+#include <ctype.h>
 #include <sys/socket.h> /* socket, connect */
 #include <netinet/in.h> /* struct sockaddr_in, struct sockaddr */
 #include <netdb.h>      /* struct hostent, gethostbyname */
 #include <arpa/inet.h>
 #include "helpers.h"
 #include "requests.h"
+#include "transport.h"
 #include "parson.h"
+#include "arena.h"
+#include "cookiejar.h"
+#include "sessioncache.h"
 #include "client.h"
 
-/* return an array of strings representing the lines of the input string
- * NOTE: the caller is responsible for freeing the returned result
+// where requests go, SERVER_HOST unless it's overridden from the environment
+static char *server_host = SERVER_HOST;
+
+// the status code of the last response printed, 0 if there wasn't one
+static int last_status;
+
+// recent response times of the commands that can be hedged
+static latency_history enter_library_latency;
+static latency_history get_book_latency;
+
+/* returns the latency budget of a command's requests, which can be changed
+ * from the environment so that every command gets its own
  */
-char **split_string_into_lines(char *string, int *line_n)
+request_budget command_budget(const char *command)
 {
-    // we'll tokenize by newlines
-    char *token = strtok(string, "\n");
-    int i = 0;
-    char **lines = calloc(100, sizeof(char *));
-    if (lines == NULL) {
-        perror("calloc");
-        exit(EXIT_FAILURE);
-    }
+    request_budget budget = { CONNECT_BUDGET, SEND_BUDGET, FIRST_BYTE_BUDGET, BODY_BUDGET };
+    char name[LINELEN];
 
-    // and add the tokens to our result
-    while (token != NULL) {
-        lines[i] = token;
-        i++;
-        token = strtok(NULL, "\n");
-    }
+    snprintf(name, LINELEN, "%s%s", BUDGET_ENV_PREFIX, command);
+    for (char *c = name; *c != '\0'; c++)
+        *c = toupper(*c);
 
-    *line_n = i;
+    char *value = getenv(name);
+    if (value != NULL)
+        sscanf(value, "%d,%d,%d,%d", &budget.connect, &budget.send,
+               &budget.first_byte, &budget.body);
 
-    return lines;
+    return budget;
 }
 
-/* ask for a username and a password and return a formatted
- * JSON string containing that information
- * NOTE: the caller is responsible for freeing the returned string
+/* returns how long to wait before hedging requests with the given response
+ * time history, or -1 if hedging is turned off
+ */
+int hedge_delay(const latency_history *history)
+{
+    char *value = getenv(HEDGE_PERCENTILE_ENV);
+    if (value == NULL)
+        return -1;
+
+    int percentile = atoi(value);
+    if (percentile <= 0 || percentile > 100)
+        return -1;
+
+    return latency_percentile(history, percentile, HEDGE_DEFAULT_DELAY);
+}
+
+/* sends the side effect free requests of a command, hedged if that's turned
+ * on, and adds how long they took to its response time history
+ * NOTE: the caller is responsible for freeing the returned array and responses
+ */
+response **make_get_requests(const char *command, latency_history *history, char **messages,
+                             int count, request_status *statuses)
+{
+    request_budget budget = command_budget(command);
+    long long start = clock_ms();
+    int answered = 1;
+
+    response **responses = make_hedged_requests(server_host, HTTP_PORT, messages, count,
+                                                &budget, statuses, hedge_delay(history));
+
+    for (int i = 0; i < count; i++)
+        answered = answered && responses[i] != NULL;
+
+    if (answered)
+        latency_record(history, (int) (clock_ms() - start));
+
+    return responses;
+}
+
+/* parses the JSON body of a response into an arena, so that all of it is
+ * released at once with arena_destroy instead of node by node
+ * NOTE: keys and strings are unescaped in place, so they point into the body
+ * and the response has to outlive the value
+ */
+JSON_Value *parse_body(response *response, arena *values)
+{
+    json_arena_begin(values);
+    JSON_Value *value = json_parse_string_in_situ(response_body(response, NULL));
+    json_arena_end();
+
+    return value;
+}
+
+// prints the status of a successful response followed by what the command did
+void print_success(response *response, const char *message)
+{
+    last_status = response->status_code;
+    printf("%d - %.*s - %s\n", response->status_code, (int) response->reason_size,
+           response->raw.data + response->reason, message);
+}
+
+/* prints the status of a response that wasn't successful followed by the
+ * error in its already parsed JSON body, if there is one
+ */
+void print_failure_body(response *response, JSON_Object *body)
+{
+    const char *error = json_object_get_string(body, "error");
+
+    last_status = response->status_code;
+    printf("%d - %.*s", response->status_code, (int) response->reason_size,
+           response->raw.data + response->reason);
+    if (error != NULL)
+        printf(" - %s", error);
+    printf("\n");
+}
+
+/* prints the status of a response that wasn't successful followed by the
+ * error the server sent in its JSON body, if there is one
+ */
+void print_failure(response *response)
+{
+    arena values;
+
+    arena_init(&values);
+
+    JSON_Value *json_response_value = parse_body(response, &values);
+    print_failure_body(response, json_value_get_object(json_response_value));
+
+    arena_destroy(&values);
+}
+
+/* ask for a username and a password and return a JSON object
+ * containing that information
+ * NOTE: the caller is responsible for freeing the returned value
  */
-char *user_pass_prompt()
+JSON_Value *user_pass_prompt()
 {
     char user_input_buffer[BUFLEN];
     char username[BUFLEN];
@@ -72,260 +172,236 @@ char *user_pass_prompt()
     json_object_set_string(root_obj, "username", username);
     json_object_set_string(root_obj, "password", password);
 
-    char *JSON_raw = json_serialize_to_string_pretty(root);
-
-    json_value_free(root);
-
-    return JSON_raw;
+    return root;
 }
 
 // represents the "register" command
 void register_user()
 {
-    char *message;
-    char *response;
-    int sockfd;
+    request message;
+    response *response;
+    request_budget budget = command_budget("register");
+    request_status status;
 
     // get username and password from user and generate JSON
-    char *JSON_raw = user_pass_prompt();
-    if (JSON_raw == NULL)
+    JSON_Value *credentials = user_pass_prompt();
+    if (credentials == NULL)
         return;
 
-    // split JSON into lines to make it easier to use compute_post_request
-    int JSON_raw_line_n;
-    char **JSON_raw_lines = split_string_into_lines(JSON_raw,
-                                                &JSON_raw_line_n);
-
-    // generate raw HTTP post request
-    message = compute_post_request(SERVER_IP,
-                "/api/v1/tema/auth/register", "application/json",
-                JSON_raw_lines, JSON_raw_line_n, NULL, 0);
+    // generate raw HTTP post request, the JSON is written right into it
+    message = compute_post_request_json(server_host, HTTP_PORT, "/api/v1/tema/auth/register",
+                                        credentials, NULL, 0, NULL);
+    json_value_free(credentials);
+    if (message.data == NULL) {
+        printf("The request couldn't be built!\n");
+        return;
+    }
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
-
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
-
-    close_connection(sockfd);
-
-    // check response
-    char *json_response = basic_extract_json_response(response);
-
-    // if there's no JSON, the request was successful, otherwise print error
-    if (json_response == NULL)
-        printf("201 - OK - Successfully registered\n");
-    else {
-        JSON_Value *json_response_value = json_parse_string(json_response);
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
-
-        if (error)
-            printf("400 - Bad Request - %s\n", error);
-
-        json_value_free(json_response_value);
+    response = make_request_iov(server_host, HTTP_PORT, message.iov, REQUEST_PARTS,
+                                &budget, &status);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        request_destroy(&message);
+        return;
     }
 
-    // free memory
-    json_free_serialized_string(JSON_raw);
-    free(JSON_raw_lines);
-    free(message);
-    free(response);
-}
-
-// extracts cookie from an HTTP response
-char *get_cookie(char *response)
-{
-    int response_line_n;
-    char **response_lines = split_string_into_lines(response,
-                                                &response_line_n);
-    char *cookie = NULL;
-
-    for (int i = 0; i < response_line_n; i++)
-        if (strstr(response_lines[i], "Set-Cookie") != NULL) {
-            char *token = strtok(response_lines[i], " ;");
-
-            while (token != NULL) {
-                if (strstr(token, "connect.sid") != NULL) {
-                    cookie = calloc(strlen(token) + 1, sizeof(char));
-                    if (cookie == NULL) {
-                        perror("calloc");
-                        exit(EXIT_FAILURE);
-                    }
-
-
-                    strcpy(cookie, token);
-                    break;
-                }
-
-                token = strtok(NULL, " ;");
-            }
-
-            break;
-        }
+    // print success or the error the server sent
+    if (response_is_success(response))
+        print_success(response, "Successfully registered");
+    else
+        print_failure(response);
 
     // free memory
-    free(response_lines);
-
-    return cookie;
+    request_destroy(&message);
+    response_free(response);
 }
 
-// represents the "login" command
-char *login()
+/* represents the "login" command, the cookies the server sets are stored in
+ * jar, returns how many there were
+ */
+int login(cookie_jar *jar)
 {
-    char *message;
-    char *response;
-    char *cookie = NULL;
-    int sockfd;
+    request message;
+    response *response;
+    int cookies_n = 0;
+    request_budget budget = command_budget("login");
+    request_status status;
 
     // get username and password from user and generate JSON
-    char *JSON_raw = user_pass_prompt();
-
-    // split JSON into lines to make it easier to use compute_post_request
-    int JSON_raw_line_n;
-    char **JSON_raw_lines = split_string_into_lines(JSON_raw,
-                                                &JSON_raw_line_n);
-
-    // generate the raw text http request
-    message = compute_post_request(SERVER_IP, "/api/v1/tema/auth/login",
-                "application/json", JSON_raw_lines, JSON_raw_line_n, NULL, 0);
-
+    JSON_Value *credentials = user_pass_prompt();
+    if (credentials == NULL)
+        return 0;
+
+    // generate the raw text http request, the JSON is written right into it
+    message = compute_post_request_json(server_host, HTTP_PORT, "/api/v1/tema/auth/login",
+                                        credentials, NULL, 0, NULL);
+    json_value_free(credentials);
+    if (message.data == NULL) {
+        printf("The request couldn't be built!\n");
+        return 0;
+    }
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
-
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
-
-    close_connection(sockfd);
-
-    char *json_response = basic_extract_json_response(response);
+    response = make_request_iov(server_host, HTTP_PORT, message.iov, REQUEST_PARTS,
+                                &budget, &status);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        request_destroy(&message);
+        return 0;
+    }
 
-    // check for errors based on whether we received JSON or not
-    if (json_response == NULL) {
-        printf("200 - OK - Successfully logged in\n");
-        cookie = get_cookie(response);
+    // keep the session cookies if the server accepted the credentials
+    if (response_is_success(response)) {
+        print_success(response, "Successfully logged in");
+        cookies_n = cookie_jar_update(jar, response);
     } else {
-        JSON_Value *json_response_value = json_parse_string(json_response);
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
-
-        if (error)
-            printf("400 - Bad Request - %s\n", error);
-
-        json_value_free(json_response_value);
+        print_failure(response);
     }
 
     // free memory
-    json_free_serialized_string(JSON_raw);
-    free(JSON_raw_lines);
-    free(message);
-    free(response);
+    request_destroy(&message);
+    response_free(response);
 
-    return cookie;
+    return cookies_n;
 }
 
 // represents the "enter_library" command
-char *enter_library(char **cookies, int cookies_n)
+char *enter_library(const session_headers *session)
 {
     char *auth_token = NULL;
     char *message;
-    char *response;
-    int sockfd;
+    response **responses;
+    response *response;
+    request_status status;
 
-    // generate the raw text http GET request
-    message = compute_get_request(SERVER_IP, "/api/v1/tema/library/access",
-                NULL, cookies, cookies_n);
+    // generate the raw text http GET request, with the session's cookies
+    request_spec spec = { .method = "GET", .url = "/api/v1/tema/library/access", .session = session };
+    message = compute_request(&spec, NULL);
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
+    responses = make_get_requests("enter_library", &enter_library_latency, &message, 1, &status);
+    response = responses[0];
+    free(responses);
 
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        free(message);
+        return NULL;
+    }
 
-    close_connection(sockfd);
+    arena values;
 
-    char *json_response = basic_extract_json_response(response);
+    arena_init(&values);
 
-    JSON_Value *json_response_value = json_parse_string(json_response);
+    JSON_Value *json_response_value = parse_body(response, &values);
     JSON_Object *json_response_object = json_value_get_object(json_response_value);
 
     // try to extract the authentication token
     const char *result = json_object_get_string(json_response_object, "token");
 
     // if there's no token, print error, otherwise save it
-    if (result == NULL) {
-        const char *error = json_object_get_string(json_response_object, "error");
-        if (error)
-            printf("400 - Bad Request - %s\n", error);
+    if (!response_is_success(response) || result == NULL) {
+        print_failure_body(response, json_response_object);
     } else {
-        printf("200 - OK - Successfully entered library\n");
+        print_success(response, "Successfully entered library");
         auth_token = calloc(strlen(result) + 1, sizeof(char));
         strcpy(auth_token, result);
     }
 
     // free memory
-    json_value_free(json_response_value);
+    arena_destroy(&values);
     free(message);
-    free(response);
+    response_free(response);
 
     return auth_token;
 }
 
-// represents the "get_books" command
-void get_books(char **cookies, int cookies_n, char *auth_token)
+// picks the id and title of every book out of the list and prints the book once it's complete
+void book_listing_event(void *context, int event, const char *data, size_t size)
 {
-    char *message;
-    char *response;
-    int sockfd;
+    book_listing *listing = context;
+    int depth = listing->parser.depth;
 
-    // generate the raw text http GET request with authentication
-    message = compute_get_request_auth(SERVER_IP, "/api/v1/tema/library/books",
-                NULL, cookies, cookies_n, auth_token);
+    if (depth == 0 && event == JSON_STREAM_BEGIN_ARRAY)
+        listing->is_list = 1;
 
-    // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
+    // the books are the objects right inside the list, their fields one level deeper
+    if (!listing->is_list || depth == 0 || depth > 2)
+        return;
 
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
+    if (event == JSON_STREAM_BEGIN_OBJECT && depth == 1) {
+        listing->field = BOOK_FIELD_OTHER;
+        listing->id = 0;
+        listing->has_title = 0;
+    } else if (event == JSON_STREAM_END_OBJECT && depth == 1) {
+        printf("%ld: %s\n", listing->id, listing->has_title ? listing->title : "(null)");
+    } else if (event == JSON_STREAM_KEY) {
+        listing->field = strcmp(data, "id") == 0 ? BOOK_FIELD_ID
+                         : strcmp(data, "title") == 0 ? BOOK_FIELD_TITLE : BOOK_FIELD_OTHER;
+    } else if (event == JSON_STREAM_NUMBER && listing->field == BOOK_FIELD_ID) {
+        listing->id = strtol(data, NULL, 10);
+    } else if (event == JSON_STREAM_STRING && listing->field == BOOK_FIELD_TITLE) {
+        if (size + 1 > listing->title_capacity) {
+            listing->title_capacity = size + 1;
+            listing->title = realloc(listing->title, listing->title_capacity);
+            if (listing->title == NULL) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
 
-    close_connection(sockfd);
+        memcpy(listing->title, data, size + 1);
+        listing->has_title = 1;
+    }
+}
 
-    char *json_response = basic_extract_json_response(response);
+// feeds the body of a successful "get_books" response to the parser as it arrives
+void book_listing_feed(response *response, const char *data, size_t size, void *context)
+{
+    book_listing *listing = context;
 
-    // parse book array
-    JSON_Value *json_response_value = json_parse_string(json_response);
-    JSON_Array *json_response_array = json_value_get_array(json_response_value);
+    if (!listing->printed) {
+        print_success(response, "Successfully retrieved books");
+        listing->printed = 1;
+    }
 
-    if (json_response_array == NULL) {
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
+    json_stream_feed(&listing->parser, data, size);
+}
 
-        printf("400 - Bad Request - %s\n", error);
+/* represents the "get_books" command, books are printed as soon as they are
+ * received, so the list is never whole in memory however long it is
+ */
+void get_books(const session_headers *session)
+{
+    char *message;
+    response *response;
+    request_budget budget = command_budget("get_books");
+    request_status status;
+    book_listing listing = { 0 };
 
-        json_value_free(json_response_value);
-        free(message);
-        free(response);
-        return;
-    } else {
-        printf("200 - OK - Successfully retrieved books\n");
-    }
+    json_stream_init(&listing.parser, book_listing_event, &listing);
 
-    int n = json_array_get_count(json_response_array);
+    // generate the raw text http GET request with authentication
+    request_spec spec = { .method = "GET", .url = "/api/v1/tema/library/books", .session = session };
+    message = compute_request(&spec, NULL);
 
-    // print each book
-    for (int i = 0; i < n; i++) {
-        JSON_Object *json_object = json_array_get_object(json_response_array, i);
-        long int id = (long int) json_object_get_number(json_object, "id");
-        const char *title = json_object_get_string(json_object, "title");
+    // make the HTTP request, the books are printed while it's running
+    response = make_streamed_request(server_host, HTTP_PORT, message, &budget, &status,
+                                     book_listing_feed, &listing);
 
-        printf("%ld: %s\n", id, title);
-    }
+    if (response == NULL)
+        printf("%s!\n", request_status_message(&status));
+    else if (!response_is_success(response))
+        print_failure(response);
+    else if (json_stream_finish(&listing.parser) < 0 || !listing.is_list)
+        printf("The server sent an invalid list of books!\n");
 
     // free memory
-    json_value_free(json_response_value);
+    json_stream_destroy(&listing.parser);
+    free(listing.title);
     free(message);
-    free(response);
+    response_free(response);
 }
 
 /* asks the user for a book id and the generates the url
@@ -355,46 +431,66 @@ char *id_prompt()
     return url;
 }
 
-// represents the "get_book" command
-void get_book(char **cookies, int cookies_n, char *auth_token)
+/* asks the user for one or more book ids separated by spaces and generates
+ * their urls
+ * NOTE: the caller is responsible for freeing the returned urls and array
+ */
+char **ids_prompt(int *ids_n)
 {
-    char *message;
-    char *response;
-    int sockfd;
+    char ids[BUFLEN];
+    char **urls = calloc(BUFLEN / 2, sizeof(char *));
+    if (urls == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
 
-    // get book id and generate url
-    char *url = id_prompt();
+    printf("id=");
+    fgets(ids, BUFLEN, stdin);
+    ids[strlen(ids) - 1] = '\0';
+
+    *ids_n = 0;
+    for (char *id = strtok(ids, " "); id != NULL; id = strtok(NULL, " ")) {
+        urls[*ids_n] = calloc(strlen("/api/v1/tema/library/books/") + strlen(id) + 1, sizeof(char));
+        if (urls[*ids_n] == NULL) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
 
-    // generate the raw text http GET request with authentication
-    message = compute_get_request_auth(SERVER_IP, url, NULL, cookies,
-                                        cookies_n, auth_token);
+        sprintf(urls[*ids_n], "/api/v1/tema/library/books/%s", id);
+        (*ids_n)++;
+    }
 
-    // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
+    if (*ids_n == 0) {
+        printf("You have to enter an ID, try again!\n");
+        free(urls);
+        return NULL;
+    }
 
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
+    return urls;
+}
 
-    close_connection(sockfd);
+// prints a book from a "get_book" response, or the error the server sent instead
+void print_book(response *response)
+{
+    arena values;
 
-    char *json_response = basic_extract_json_response(response);
-    JSON_Value *json_response_value = json_parse_string(json_response);
-    JSON_Object *json_response_object = json_value_get_object(json_response_value);
+    arena_init(&values);
 
-    const char *error = json_object_get_string(json_response_object, "error");
+    JSON_Value *json_response_value = parse_body(response, &values);
+    JSON_Object *json_response_object = json_value_get_object(json_response_value);
 
     // if there's an error, print it, otherwise print the book
-    if (error != NULL) {
-        printf("404 - Not Found - %s\n", error);
+    if (!response_is_success(response) || json_response_object == NULL) {
+        print_failure_body(response, json_response_object);
     } else {
-        printf("200 - OK - Successfully retrieved book\n");
+        print_success(response, "Successfully retrieved book");
 
-        long int id = (long int) json_object_get_number(json_response_object, "id");
+        long int id = json_object_get_integer(json_response_object, "id");
         const char *title = json_object_get_string(json_response_object, "title");
         const char *author = json_object_get_string(json_response_object, "author");
         const char *publisher = json_object_get_string(json_response_object, "publisher");
         const char *genre = json_object_get_string(json_response_object, "genre");
-        long int page_count = (long int) json_object_get_number(json_response_object, "page_count");
+        long int page_count = json_object_get_integer(json_response_object, "page_count");
 
         printf("ID: %ld\n", id);
         printf("Title: %s\n", title);
@@ -404,25 +500,76 @@ void get_book(char **cookies, int cookies_n, char *auth_token)
         printf("Page count: %ld\n", page_count);
     }
 
+    arena_destroy(&values);
+}
+
+/* represents the "get_book" command, several ids separated by spaces are
+ * fetched at once with pipelined requests on the same connection
+ */
+void get_book(const session_headers *session)
+{
+    int ids_n;
+
+    // get book ids and generate urls
+    char **urls = ids_prompt(&ids_n);
+    if (urls == NULL)
+        return;
+
+    // generate the raw text http GET requests with authentication
+    char **messages = calloc(ids_n, sizeof(char *));
+    if (messages == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // only the request line differs between them, the rest is copied from the session
+    for (int i = 0; i < ids_n; i++) {
+        request_spec spec = { .method = "GET", .url = urls[i], .session = session };
+        messages[i] = compute_request(&spec, NULL);
+    }
+
+    request_status *statuses = calloc(ids_n, sizeof(request_status));
+    if (statuses == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // make the HTTP requests, back to back
+    response **responses = make_get_requests("get_book", &get_book_latency, messages, ids_n,
+                                             statuses);
+
+    for (int i = 0; i < ids_n; i++) {
+        if (responses[i] == NULL)
+            printf("%s!\n", request_status_message(&statuses[i]));
+        else
+            print_book(responses[i]);
+    }
+
     // free memory
-    json_value_free(json_response_value);
-    free(message);
-    free(response);
-    free(url);
+    for (int i = 0; i < ids_n; i++) {
+        free(messages[i]);
+        response_free(responses[i]);
+        free(urls[i]);
+    }
+    free(messages);
+    free(responses);
+    free(statuses);
+    free(urls);
 }
 
 // represents the "delete_book" command
-void add_book(char **cookies, int cookies_n, char *auth_token)
+void add_book(const session_headers *session)
 {
-    char *message;
-    char *response;
-    int sockfd;
+    request message;
+    response *response;
     char title[BUFLEN];
     char author[BUFLEN];
     char genre[BUFLEN];
     char publisher[BUFLEN];
     char page_count_string[BUFLEN];
-    double page_count;
+    long long page_count;
+    request_budget budget = command_budget("add_book");
+    request_status status;
 
     // get book info from user
     printf("title=");
@@ -453,7 +600,7 @@ void add_book(char **cookies, int cookies_n, char *auth_token)
         }
     }
 
-    page_count = atof(page_count_string);
+    page_count = strtoll(page_count_string, NULL, 10);
 
     // generate the JSON for the book
     JSON_Value *root = json_value_init_object();
@@ -463,180 +610,201 @@ void add_book(char **cookies, int cookies_n, char *auth_token)
     json_object_set_string(root_obj, "author", author);
     json_object_set_string(root_obj, "genre", genre);
     json_object_set_string(root_obj, "publisher", publisher);
-    json_object_set_number(root_obj, "page_count", page_count);
-
-    char *JSON_raw = json_serialize_to_string_pretty(root);
-    int JSON_raw_line_n;
-    char **JSON_raw_lines = split_string_into_lines(JSON_raw,
-                                                &JSON_raw_line_n);
+    json_object_set_integer(root_obj, "page_count", page_count);
 
     // generate the raw text http POST request with authentication
-    message = compute_post_request_auth(SERVER_IP, "/api/v1/tema/library/books",
-                                        "application/json", JSON_raw_lines,
-                                        JSON_raw_line_n, cookies, cookies_n,
-                                        auth_token);
+    request_spec spec = { .method = "POST", .url = "/api/v1/tema/library/books", .session = session };
+    message = compute_request_json(&spec, root);
+    json_value_free(root);
+    if (message.data == NULL) {
+        printf("The request couldn't be built!\n");
+        return;
+    }
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
-
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
-
-    close_connection(sockfd);
-
-    char *json_response = basic_extract_json_response(response);
-
-    // prin success or error
-    if (json_response == NULL) {
-        printf("200 - OK - Successfully added book\n");
-    } else {
-        JSON_Value *json_response_value = json_parse_string(json_response);
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
-
-        printf("400 - Bad Request - %s\n", error);
-
-        json_value_free(json_response_value);
+    response = make_request_iov(server_host, HTTP_PORT, message.iov, REQUEST_PARTS,
+                                &budget, &status);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        request_destroy(&message);
+        return;
     }
 
+    // print success or error
+    if (response_is_success(response))
+        print_success(response, "Successfully added book");
+    else
+        print_failure(response);
+
     // free memory
-    json_value_free(root);
-    json_free_serialized_string(JSON_raw);
-    free(message);
-    free(response);
-    free(JSON_raw_lines);
+    request_destroy(&message);
+    response_free(response);
 }
 
 // represents the "delete_book" command
-void delete_book(char **cookies, int cookies_n, char *auth_token)
+void delete_book(const session_headers *session)
 {
     char *message;
-    char *response;
-    int sockfd;
+    response *response;
+    request_budget budget = command_budget("delete_book");
+    request_status status;
 
     // get the id of the book from the user and generate the url
     char *url = id_prompt();
+    if (url == NULL)
+        return;
 
     // generate the raw text http DELETE request with authentication
-    message = compute_delete_request_auth(SERVER_IP, url, NULL, cookies,
-                                          cookies_n, auth_token);
+    request_spec spec = { .method = "DELETE", .url = url, .session = session };
+    message = compute_request(&spec, NULL);
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
-
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
-
-    close_connection(sockfd);
-
-    char *json_response = basic_extract_json_response(response);
+    response = make_request(server_host, HTTP_PORT, message, &budget, &status);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        free(url);
+        free(message);
+        return;
+    }
 
     // print success or error
-    if (json_response == NULL) {
-        printf("200 - OK - Successfully deleted book\n");
-    } else {
-        JSON_Value *json_response_value = json_parse_string(json_response);
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
-
-        printf("404 - Not Found - %s\n", error);
-
-        json_value_free(json_response_value);
-    }
+    if (response_is_success(response))
+        print_success(response, "Successfully deleted book");
+    else
+        print_failure(response);
 
     // free memory
     free(url);
     free(message);
-    free(response);
+    response_free(response);
 }
 
 // represents the "logout" command
-void logout(char **cookies, int cookies_n)
+void logout(cookie_jar *jar)
 {
     char *message;
-    char *response;
-    int sockfd;
-
-    // generate the raw text http GET request
-    message = compute_get_request(SERVER_IP, "/api/v1/tema/auth/logout",
-                                       NULL, cookies, cookies_n);
+    response *response;
+    request_budget budget = command_budget("logout");
+    request_status status;
+
+    // generate the raw text http GET request, it only needs the cookies, not the token
+    char *cookies = (char *) cookie_jar_header(jar);
+    request_spec spec = {
+        .method = "GET", .host = server_host, .portno = HTTP_PORT,
+        .url = "/api/v1/tema/auth/logout",
+        .cookies = &cookies, .cookies_count = cookies != NULL,
+    };
+    message = compute_request(&spec, NULL);
 
     // make the HTTP request
-    sockfd = open_connection(SERVER_IP, HTTP_PORT, AF_INET, SOCK_STREAM, 0);
-
-    send_to_server(sockfd, message);
-    response = receive_from_server(sockfd);
-
-    close_connection(sockfd);
-
-    char *json_response = basic_extract_json_response(response);
+    response = make_request(server_host, HTTP_PORT, message, &budget, &status);
+    if (response == NULL) {
+        printf("%s!\n", request_status_message(&status));
+        free(message);
+        return;
+    }
 
     // print success or error
-    if (json_response == NULL) {
-        printf("200 - OK - Successfully logged out\n");
-    } else {
-        JSON_Value *json_response_value = json_parse_string(json_response);
-        JSON_Object *json_response_object = json_value_get_object(json_response_value);
-        const char *error = json_object_get_string(json_response_object, "error");
-
-        printf("400 - Bad Request - %s\n", error);
-
-        json_value_free(json_response_value);
-    }
+    if (response_is_success(response))
+        print_success(response, "Successfully logged out");
+    else
+        print_failure(response);
 
     // free memory
     free(message);
-    free(response);
+    response_free(response);
+}
+
+// renders the header lines of the session again after its cookies or token changed
+void session_update(session_headers *session, cookie_jar *jar, char *auth_token)
+{
+    session_headers_update(session, server_host, HTTP_PORT, cookie_jar_header(jar), auth_token);
+}
+
+// saves the session for the next runs of the client, if it's kept at a path
+void session_save(const char *path, cookie_jar *jar, char *auth_token)
+{
+    if (path != NULL && jar->count > 0 && session_cache_save(path, server_host, jar, auth_token) < 0)
+        printf("The session couldn't be saved!\n");
 }
 
 int main(void)
 {
     char user_input_buffer[BUFLEN];
     char *auth_token = NULL;
-    int cookies_n = 0;
-    int cookies_cap = 100;
-    char **cookies = calloc(cookies_cap, sizeof(char *));
-    if (cookies == NULL) {
-        perror("calloc");
-        exit(EXIT_FAILURE);
+    session_headers session = { 0 };
+    cookie_jar jar;
+    int session_from_cache = 0;
+
+    cookie_jar_init(&jar);
+
+    char *host = getenv(SERVER_HOST_ENV);
+    if (host != NULL && *host != '\0' && strlen(host) < HOST_MAX_LEN)
+        server_host = host;
+
+    /* pick up the session saved by an earlier run, it's only checked by
+     * using it, so the first command doesn't wait for login and enter_library
+     */
+    char *session_cache = getenv(SESSION_CACHE_ENV);
+    if (session_cache != NULL && *session_cache == '\0')
+        session_cache = NULL;
+
+    if (session_cache != NULL && session_cache_load(session_cache, server_host, &jar, &auth_token)) {
+        session_update(&session, &jar, auth_token);
+        session_from_cache = 1;
     }
 
     // receive commands from stdin until the user sends "exit"
     while (1) {
+        /* a saved session the server refused isn't used again, one it accepted
+         * is known to be good
+         */
+        if (session_from_cache && (last_status == HTTP_UNAUTHORIZED || last_status == HTTP_FORBIDDEN)) {
+            printf("The saved session is no longer valid, log in again!\n");
+            session_cache_remove(session_cache);
+            free(auth_token);
+            auth_token = NULL;
+            cookie_jar_clear(&jar);
+            session_headers_destroy(&session);
+            session_from_cache = 0;
+        } else if (last_status >= 200 && last_status < 300) {
+            session_from_cache = 0;
+        }
+
+        last_status = 0;
         fgets(user_input_buffer, BUFLEN, stdin);
 
+        // cookies that expired in the meantime aren't sent anymore
+        if (cookie_jar_expire(&jar, time(NULL)) > 0)
+            session_update(&session, &jar, auth_token);
+
         if (strcmp(user_input_buffer, "register\n") == 0) {
+            // connect while the user types in the prompts
+            pool_preconnect(server_host, HTTP_PORT);
             register_user();
         }
         else if(strcmp(user_input_buffer, "login\n") == 0) {
-            char *cookie = login();
-
-            if (cookie == NULL)
-                continue;
-
-            // reallocate memory if necessary
-            if (cookies_n == cookies_cap) {
-                cookies_cap *= 2;
-                cookies = realloc(cookies, cookies_cap * sizeof(char *));
-                if (cookies == NULL) {
-                    perror("realloc");
-                    exit(EXIT_FAILURE);
-                }
+            pool_preconnect(server_host, HTTP_PORT);
+            // cookies set again replace the old ones, so logging in again doesn't add up
+            if (login(&jar) > 0) {
+                session_update(&session, &jar, auth_token);
+                session_save(session_cache, &jar, auth_token);
+                session_from_cache = 0;
             }
-
-            // add cookie to cookie list
-            cookies[cookies_n++] = cookie;
         }
         else if (strcmp(user_input_buffer, "enter_library\n") == 0) {
             /* check if user is logged in and don't bother sending the request
              * if not since we know it would result in an error anyway
              */
-            if (cookies_n == 0) {
+            if (jar.count == 0) {
                 printf("You are not logged in!\n");
                 continue;
             }
 
-            auth_token = enter_library(cookies, cookies_n);
+            free(auth_token);
+            auth_token = enter_library(&session);
+            session_update(&session, &jar, auth_token);
+            session_save(session_cache, &jar, auth_token);
         }
         else if (strcmp(user_input_buffer, "get_books\n") == 0) {
             /* check if user has an auth token and don't bother sending the
@@ -647,7 +815,7 @@ int main(void)
                 continue;
             }
 
-            get_books(cookies, cookies_n, auth_token);
+            get_books(&session);
         }
         else if (strcmp(user_input_buffer, "get_book\n") == 0) {
             if (auth_token == NULL) {
@@ -655,7 +823,8 @@ int main(void)
                 continue;
             }
 
-            get_book(cookies, cookies_n, auth_token);
+            pool_preconnect(server_host, HTTP_PORT);
+            get_book(&session);
         }
         else if (strcmp(user_input_buffer, "add_book\n") == 0) {
             if (auth_token == NULL) {
@@ -663,7 +832,8 @@ int main(void)
                 continue;
             }
 
-            add_book(cookies, cookies_n, auth_token);
+            pool_preconnect(server_host, HTTP_PORT);
+            add_book(&session);
         }
         else if (strcmp(user_input_buffer, "delete_book\n") == 0) {
             if (auth_token == NULL) {
@@ -671,25 +841,26 @@ int main(void)
                 continue;
             }
 
-            delete_book(cookies, cookies_n, auth_token);
+            pool_preconnect(server_host, HTTP_PORT);
+            delete_book(&session);
         }
         else if (strcmp(user_input_buffer, "logout\n") == 0) {
-            if (cookies_n == 0) {
+            if (jar.count == 0) {
                 printf("You are not logged in!\n");
                 continue;
             }
 
-            logout(cookies, cookies_n);
+            logout(&jar);
 
             // remove session info like auth token and cookies
             if (auth_token != NULL)
                 free(auth_token);
             auth_token = NULL;
-            for (int i = 0; i < cookies_n; i++) {
-                free(cookies[i]);
-                cookies[i] = NULL;
-            }
-            cookies_n = 0;
+            cookie_jar_clear(&jar);
+            session_headers_destroy(&session);
+
+            if (session_cache != NULL)
+                session_cache_remove(session_cache);
         }
         else if (strcmp(user_input_buffer, "exit\n") == 0) {
             break;
@@ -700,11 +871,11 @@ int main(void)
     }
 
     // free memory
-    for (int i = 0; i < cookies_n; i++)
-        free(cookies[i]);
-    free(cookies);
+    cookie_jar_destroy(&jar);
     if (auth_token != NULL)
         free(auth_token);
+    session_headers_destroy(&session);
+    pool_destroy();
 
     return 0;
 }
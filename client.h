@@ -1,5 +1,48 @@
 #ifndef CLIENT_H
 #define CLIENT_H
-    #define SERVER_IP "34.254.242.81"
+    #include "jsonstream.h"
+
+    // the server can be a host name or an IPv4/IPv6 address
+    #define SERVER_HOST "34.254.242.81"
+    #define SERVER_HOST_ENV "SERVER_HOST"
     #define HTTP_PORT 8080
+
+    // status codes with which the server refuses a session
+    #define HTTP_UNAUTHORIZED 401
+    #define HTTP_FORBIDDEN 403
+
+    /* default latency budgets of a command's requests in milliseconds,
+     * BUDGET_<COMMAND> overrides them with "connect,send,first_byte,body"
+     */
+    #define BUDGET_ENV_PREFIX "BUDGET_"
+    #define CONNECT_BUDGET 5000
+    #define SEND_BUDGET 5000
+    #define FIRST_BYTE_BUDGET 10000
+    #define BODY_BUDGET 10000
+
+    /* set to a percentile (95 for example) to send get_book and enter_library
+     * requests again when they take longer than that percentile of their
+     * recent response times
+     */
+    #define HEDGE_PERCENTILE_ENV "HEDGE_PERCENTILE"
+    #define HEDGE_DEFAULT_DELAY 200
+
+    // the fields of a book that get_books prints
+    #define BOOK_FIELD_OTHER 0
+    #define BOOK_FIELD_ID 1
+    #define BOOK_FIELD_TITLE 2
+
+    /* what get_books keeps while the list of books streams in, which is only
+     * ever the book being read
+     */
+    typedef struct {
+        json_stream parser;
+        int printed;
+        int is_list;
+        int field;
+        long int id;
+        char *title;
+        size_t title_capacity;
+        int has_title;
+    } book_listing;
 #endif
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "cookiejar.h"
+#include "builder.h"
+
+void cookie_jar_init(cookie_jar *jar)
+{
+    jar->cookies = NULL;
+    jar->count = 0;
+    jar->capacity = 0;
+    jar->next_expiry = COOKIE_SESSION;
+    jar->header = NULL;
+}
+
+// returns a NUL-terminated copy of size bytes of data
+static char *copy_string(const char *data, size_t size)
+{
+    char *copy = malloc(size + 1);
+    if (copy == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(copy, data, size);
+    copy[size] = '\0';
+
+    return copy;
+}
+
+// moves start and end inwards past spaces and tabs
+static void trim(const char **start, const char **end)
+{
+    while (*start < *end && (**start == ' ' || **start == '\t'))
+        (*start)++;
+
+    while (*end > *start && ((*end)[-1] == ' ' || (*end)[-1] == '\t'))
+        (*end)--;
+}
+
+/* parses an Expires date, like "Wed, 21 Oct 2015 07:28:00 GMT" or the older
+ * "Wednesday, 21-Oct-15 07:28:00 GMT", returns COOKIE_SESSION if it can't
+ */
+static time_t parse_expires(const char *value, size_t size)
+{
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char date[COOKIE_DATE_MAX_LEN], month[4];
+    struct tm tm = { 0 };
+    const char *comma;
+
+    if (size >= sizeof(date))
+        return COOKIE_SESSION;
+
+    memcpy(date, value, size);
+    date[size] = '\0';
+
+    // the week day isn't needed
+    comma = strchr(date, ',');
+    if (sscanf(comma != NULL ? comma + 1 : date, "%d%*[ -]%3s%*[ -]%d %d:%d:%d",
+               &tm.tm_mday, month, &tm.tm_year, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return COOKIE_SESSION;
+
+    for (tm.tm_mon = 0; tm.tm_mon < 12; tm.tm_mon++) {
+        if (strncasecmp(months + 3 * tm.tm_mon, month, 3) == 0)
+            break;
+    }
+
+    if (strlen(month) != 3 || tm.tm_mon == 12)
+        return COOKIE_SESSION;
+
+    // two digit years are 1970-2069, as RFC 6265 says
+    if (tm.tm_year < 70)
+        tm.tm_year += 2000;
+    else if (tm.tm_year < 100)
+        tm.tm_year += 1900;
+
+    tm.tm_year -= 1900;
+
+    return timegm(&tm);
+}
+
+// finds the cookie called name, returns its index or -1
+static int cookie_jar_find(cookie_jar *jar, const char *name, size_t name_size)
+{
+    for (int i = 0; i < jar->count; i++) {
+        if (strlen(jar->cookies[i].name) == name_size
+            && memcmp(jar->cookies[i].name, name, name_size) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+// removes the cookie at index, the last one takes its place
+static void cookie_jar_remove(cookie_jar *jar, int index)
+{
+    free(jar->cookies[index].name);
+    free(jar->cookies[index].value);
+    jar->cookies[index] = jar->cookies[--jar->count];
+}
+
+// builds the Cookie header again and finds out when the next cookie expires
+static void cookie_jar_changed(cookie_jar *jar)
+{
+    builder header;
+    size_t size = 0;
+
+    free(jar->header);
+    jar->header = NULL;
+    jar->next_expiry = COOKIE_SESSION;
+
+    if (jar->count == 0)
+        return;
+
+    for (int i = 0; i < jar->count; i++) {
+        size += strlen(jar->cookies[i].name) + 1 + strlen(jar->cookies[i].value) + 2;
+
+        time_t expires = jar->cookies[i].expires;
+        if (expires != COOKIE_SESSION && (jar->next_expiry == COOKIE_SESSION || expires < jar->next_expiry))
+            jar->next_expiry = expires;
+    }
+
+    builder_init(&header, size);
+
+    for (int i = 0; i < jar->count; i++) {
+        if (i > 0)
+            builder_add(&header, "; ", 2);
+        builder_add_string(&header, jar->cookies[i].name);
+        builder_add(&header, "=", 1);
+        builder_add_string(&header, jar->cookies[i].value);
+    }
+
+    jar->header = builder_release(&header);
+}
+
+int cookie_jar_set(cookie_jar *jar, const char *value, size_t value_size, time_t now)
+{
+    const char *end = value + value_size;
+    const char *pair_end = memchr(value, ';', value_size);
+    const char *equals;
+    time_t expires = COOKIE_SESSION;
+    int has_max_age = 0;
+
+    if (pair_end == NULL)
+        pair_end = end;
+
+    // the cookie itself is "name=value", the attributes come after the first ';'
+    equals = memchr(value, '=', pair_end - value);
+    if (equals == NULL)
+        return 0;
+
+    const char *name = value, *name_end = equals;
+    const char *cookie_value = equals + 1, *cookie_value_end = pair_end;
+
+    trim(&name, &name_end);
+    trim(&cookie_value, &cookie_value_end);
+    if (name == name_end)
+        return 0;
+
+    for (const char *attribute = pair_end; attribute < end; ) {
+        const char *attribute_end = memchr(attribute + 1, ';', end - attribute - 1);
+        if (attribute_end == NULL)
+            attribute_end = end;
+
+        const char *key = attribute + 1, *key_end = memchr(key, '=', attribute_end - key);
+        const char *data = key_end != NULL ? key_end + 1 : attribute_end, *data_end = attribute_end;
+
+        if (key_end == NULL)
+            key_end = attribute_end;
+
+        trim(&key, &key_end);
+        trim(&data, &data_end);
+
+        // Max-Age wins over Expires, Path, Domain and the flags don't matter for one server
+        if (key_end - key == 7 && strncasecmp(key, "Max-Age", 7) == 0 && data < data_end) {
+            long long seconds = strtoll(data, NULL, 10);
+
+            expires = seconds <= 0 ? 0 : now + seconds;
+            has_max_age = 1;
+        } else if (key_end - key == 7 && strncasecmp(key, "Expires", 7) == 0 && !has_max_age) {
+            expires = parse_expires(data, data_end - data);
+        }
+
+        attribute = attribute_end;
+    }
+
+    cookie_jar_put(jar, name, name_end - name, cookie_value, cookie_value_end - cookie_value,
+                   expires, now);
+
+    return 1;
+}
+
+void cookie_jar_put(cookie_jar *jar, const char *name, size_t name_size,
+                    const char *value, size_t value_size, time_t expires, time_t now)
+{
+    int index = cookie_jar_find(jar, name, name_size);
+
+    if (expires != COOKIE_SESSION && expires <= now) {
+        // an expired cookie is how a server deletes one
+        if (index >= 0) {
+            cookie_jar_remove(jar, index);
+            cookie_jar_changed(jar);
+        }
+        return;
+    }
+
+    if (index < 0) {
+        if (jar->count == jar->capacity) {
+            jar->capacity = jar->capacity > 0 ? 2 * jar->capacity : 4;
+            jar->cookies = realloc(jar->cookies, jar->capacity * sizeof(cookie));
+            if (jar->cookies == NULL) {
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        index = jar->count++;
+        jar->cookies[index].name = copy_string(name, name_size);
+    } else {
+        free(jar->cookies[index].value);
+    }
+
+    jar->cookies[index].value = copy_string(value, value_size);
+    jar->cookies[index].expires = expires;
+    cookie_jar_changed(jar);
+}
+
+int cookie_jar_update(cookie_jar *jar, response *response)
+{
+    int index = 0, count = 0;
+    size_t value_size;
+    const char *value;
+    time_t now = time(NULL);
+
+    while ((value = response_next_header_value(response, "Set-Cookie", &index, &value_size)) != NULL)
+        count += cookie_jar_set(jar, value, value_size, now);
+
+    return count;
+}
+
+int cookie_jar_expire(cookie_jar *jar, time_t now)
+{
+    int removed = 0;
+
+    if (jar->next_expiry == COOKIE_SESSION || jar->next_expiry > now)
+        return 0;
+
+    for (int i = jar->count - 1; i >= 0; i--) {
+        if (jar->cookies[i].expires != COOKIE_SESSION && jar->cookies[i].expires <= now) {
+            cookie_jar_remove(jar, i);
+            removed++;
+        }
+    }
+
+    cookie_jar_changed(jar);
+
+    return removed;
+}
+
+const char *cookie_jar_header(cookie_jar *jar)
+{
+    return jar->header;
+}
+
+void cookie_jar_clear(cookie_jar *jar)
+{
+    while (jar->count > 0)
+        cookie_jar_remove(jar, jar->count - 1);
+
+    cookie_jar_changed(jar);
+}
+
+void cookie_jar_destroy(cookie_jar *jar)
+{
+    cookie_jar_clear(jar);
+    free(jar->cookies);
+    cookie_jar_init(jar);
+}
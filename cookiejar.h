@@ -0,0 +1,65 @@
+#ifndef _COOKIEJAR_
+#define _COOKIEJAR_
+
+#include <time.h>
+#include "response.h"
+
+// when a cookie without Expires or Max-Age goes away, which is never here
+#define COOKIE_SESSION ((time_t) -1)
+
+// longest Expires date that is parsed, anything longer is ignored
+#define COOKIE_DATE_MAX_LEN 64
+
+// a cookie the server set and the wall clock time it expires at
+typedef struct {
+    char *name;
+    char *value;
+    time_t expires;
+} cookie;
+
+/* the cookies of a session, one per name, kept along with the value of the
+ * Cookie header that sends them, which is only built again when they change
+ */
+typedef struct {
+    cookie *cookies;
+    int count;
+    int capacity;
+    time_t next_expiry;
+    char *header;
+} cookie_jar;
+
+// initializes an empty cookie jar
+void cookie_jar_init(cookie_jar *jar);
+
+/* stores the cookie of a Set-Cookie header value of size value_size,
+ * replacing the one with the same name; a cookie that already expired at now
+ * removes it instead, returns 0 if the value isn't a valid cookie
+ */
+int cookie_jar_set(cookie_jar *jar, const char *value, size_t value_size, time_t now);
+
+/* stores a cookie called name, replacing the one with the same name, or
+ * removes that one if expires is already past at now
+ */
+void cookie_jar_put(cookie_jar *jar, const char *name, size_t name_size,
+                    const char *value, size_t value_size, time_t expires, time_t now);
+
+// stores the cookies of every Set-Cookie header of a response, returns how many there were
+int cookie_jar_update(cookie_jar *jar, response *response);
+
+/* removes the cookies that expired at now, returns how many went away
+ * NOTE: this is constant time unless one of them is due
+ */
+int cookie_jar_expire(cookie_jar *jar, time_t now);
+
+/* returns the value of the Cookie header that sends every cookie in the jar,
+ * NULL if it is empty
+ */
+const char *cookie_jar_header(cookie_jar *jar);
+
+// removes every cookie from the jar
+void cookie_jar_clear(cookie_jar *jar);
+
+// destroys a cookie jar
+void cookie_jar_destroy(cookie_jar *jar);
+
+#endif
@@ -4,15 +4,28 @@
 #include <string.h>     /* memcpy, memset */
 #include <sys/socket.h> /* socket, connect */
 #include <netinet/in.h> /* struct sockaddr_in, struct sockaddr */
+#include <netinet/tcp.h>
 #include <netdb.h>      /* struct hostent, gethostbyname */
 #include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include "helpers.h"
 #include "buffer.h"
+#include "response.h"
+#include "resolver.h"
 
-#define HEADER_TERMINATOR "\r\n\r\n"
-#define HEADER_TERMINATOR_SIZE (sizeof(HEADER_TERMINATOR) - 1)
-#define CONTENT_LENGTH "Content-Length: "
-#define CONTENT_LENGTH_SIZE (sizeof(CONTENT_LENGTH) - 1)
+// an idle kept-alive connection waiting to be reused
+typedef struct {
+    int sockfd;
+    int portno;
+    char host[HOST_MAX_LEN];
+} pooled_connection;
+
+// idle connections, the most recently used one is at the end
+static pooled_connection idle_pool[POOL_MAX_IDLE];
+static int idle_count;
 
 void error(const char *msg)
 {
@@ -20,130 +33,285 @@ void error(const char *msg)
     exit(0);
 }
 
-void compute_message(char *message, const char *line)
+long long clock_ms(void)
 {
-    strcat(message, line);
-    strcat(message, "\r\n");
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
 }
 
-int open_connection(char *host_ip, int portno, int ip_type, int socket_type, int flag)
+// starts the next attempts of a race until one of them is in progress
+static void race_next(connect_race *race)
 {
-    struct sockaddr_in serv_addr;
-    int sockfd = socket(ip_type, socket_type, flag);
-    if (sockfd < 0)
-        error("ERROR opening socket");
+    while (race->started < race->count) {
+        resolved_address *address = &race->addresses[race->started];
+        int sockfd = socket(address->addr.ss_family, race->socket_type | SOCK_NONBLOCK,
+                            race->protocol);
+
+        if (sockfd >= 0 && connect(sockfd, (struct sockaddr*) &address->addr, address->addr_len) < 0
+            && errno != EINPROGRESS) {
+            close(sockfd);
+            sockfd = -1;
+        }
 
-    memset(&serv_addr, 0, sizeof(serv_addr));
-    serv_addr.sin_family = ip_type;
-    serv_addr.sin_port = htons(portno);
-    inet_aton(host_ip, &serv_addr.sin_addr);
+        race->sockfds[race->started++] = sockfd;
+        race->next_attempt = clock_ms() + CONNECT_ATTEMPT_DELAY;
 
-    /* connect the socket */
-    if (connect(sockfd, (struct sockaddr*) &serv_addr, sizeof(serv_addr)) < 0)
-        error("ERROR connecting");
+        if (sockfd >= 0)
+            return;
 
-    return sockfd;
+        race->failed++;
+    }
 }
 
-void close_connection(int sockfd)
+// fills in the addresses a race goes through, returns how many there are
+static int race_resolve(connect_race *race, char *host_ip, int portno, int ip_type,
+                        int socket_type, int protocol)
 {
-    close(sockfd);
+    resolved_address addresses[RESOLVER_MAX_ADDRESSES];
+    int count = resolve_host(host_ip, portno, addresses, RESOLVER_MAX_ADDRESSES);
+
+    race->count = 0;
+    race->started = 0;
+    race->failed = 0;
+    race->socket_type = socket_type;
+    race->protocol = protocol;
+
+    for (int i = 0; i < count; i++)
+        if (ip_type == AF_UNSPEC || addresses[i].addr.ss_family == ip_type)
+            race->addresses[race->count++] = addresses[i];
+
+    return race->count;
 }
 
-void send_to_server(int sockfd, char *message)
+int race_start(connect_race *race, char *host_ip, int portno, int ip_type, int socket_type, int protocol)
 {
-    int bytes, sent = 0;
-    int total = strlen(message);
+    if (race_resolve(race, host_ip, portno, ip_type, socket_type, protocol) == 0)
+        return -1;
 
-    do
-    {
-        bytes = write(sockfd, message + sent, total - sent);
-        if (bytes < 0) {
-            error("ERROR writing message to socket");
-        }
+    race_next(race);
 
-        if (bytes == 0) {
-            break;
-        }
+    return race->failed == race->count ? -1 : 0;
+}
+
+int race_adopt(connect_race *race, int sockfd, char *host_ip, int portno)
+{
+    if (race_resolve(race, host_ip, portno, AF_UNSPEC, SOCK_STREAM | SOCK_CLOEXEC, 0) == 0)
+        return -1;
+
+    // it has been trying for a while already, so the next address starts right away
+    race->sockfds[0] = sockfd;
+    race->started = 1;
+    race->next_attempt = clock_ms();
 
-        sent += bytes;
-    } while (sent < total);
+    return 0;
 }
 
-char *receive_from_server(int sockfd)
+// closes a losing attempt, waking up anything still waiting on it
+static void race_drop(connect_race *race, int i)
 {
-    char response[BUFLEN];
-    buffer buffer = buffer_init();
-    int header_end = 0;
-    int content_length = 0;
+    shutdown(race->sockfds[i], SHUT_RDWR);
+    close(race->sockfds[i]);
+    race->sockfds[i] = -1;
+}
 
-    do {
-        int bytes = read(sockfd, response, BUFLEN);
+int race_poll(connect_race *race)
+{
+    struct pollfd fds[RESOLVER_MAX_ADDRESSES];
+    int attempts[RESOLVER_MAX_ADDRESSES];
+    int n = 0;
 
-        if (bytes < 0){
-            error("ERROR reading response from socket");
-        }
+    for (int i = 0; i < race->started; i++) {
+        if (race->sockfds[i] < 0)
+            continue;
 
-        if (bytes == 0) {
-            break;
+        fds[n].fd = race->sockfds[i];
+        fds[n].events = POLLOUT;
+        attempts[n++] = i;
+    }
+
+    if (n > 0 && poll(fds, n, 0) < 0 && errno != EINTR)
+        n = 0;
+
+    for (int j = 0; j < n; j++) {
+        int i = attempts[j];
+        int err = 0;
+        socklen_t len = sizeof(err);
+
+        if (fds[j].revents == 0)
+            continue;
+
+        if (getsockopt(race->sockfds[i], SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0
+            && !(fds[j].revents & (POLLERR | POLLHUP))) {
+            int sockfd = race->sockfds[i];
+
+            race->sockfds[i] = -1;
+            race_abort(race);
+            return sockfd;
         }
 
-        buffer_add(&buffer, response, (size_t) bytes);
+        // the next address doesn't have to wait once this one failed
+        race_drop(race, i);
+        race->failed++;
+        race->next_attempt = clock_ms();
+    }
 
-        header_end = buffer_find(&buffer, HEADER_TERMINATOR, HEADER_TERMINATOR_SIZE);
+    if (race->started < race->count && clock_ms() >= race->next_attempt)
+        race_next(race);
 
-        if (header_end >= 0) {
-            header_end += HEADER_TERMINATOR_SIZE;
+    return race->failed == race->count ? RACE_FAILED : RACE_PENDING;
+}
 
-            int content_length_start = buffer_find_insensitive(&buffer, CONTENT_LENGTH, CONTENT_LENGTH_SIZE);
+int race_timeout(connect_race *race)
+{
+    if (race->started == race->count)
+        return -1;
 
-            if (content_length_start < 0) {
-                continue;
-            }
+    long long left = race->next_attempt - clock_ms();
 
-            content_length_start += CONTENT_LENGTH_SIZE;
-            content_length = strtol(buffer.data + content_length_start, NULL, 10);
-            break;
-        }
-    } while (1);
-    size_t total = content_length + (size_t) header_end;
+    return left > 0 ? (int) left : 0;
+}
 
-    while (buffer.size < total) {
-        int bytes = read(sockfd, response, BUFLEN);
+void race_abort(connect_race *race)
+{
+    for (int i = 0; i < race->started; i++)
+        if (race->sockfds[i] >= 0)
+            race_drop(race, i);
+}
 
-        if (bytes < 0) {
-            error("ERROR reading response from socket");
-        }
+int server_address(char *host_ip, int portno, struct sockaddr_storage *serv_addr, socklen_t *addr_len)
+{
+    resolved_address address;
 
-        if (bytes == 0) {
-            break;
-        }
+    if (resolve_host(host_ip, portno, &address, 1) < 0)
+        return -1;
+
+    memcpy(serv_addr, &address.addr, address.addr_len);
+    *addr_len = address.addr_len;
+
+    return 0;
+}
 
-        buffer_add(&buffer, response, (size_t) bytes);
+int connection_is_connecting(int sockfd)
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    if (getsockopt(sockfd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return 0;
+
+    return info.tcpi_state == TCP_SYN_SENT;
+}
+
+int start_connection(char *host_ip, int portno)
+{
+    struct sockaddr_storage serv_addr;
+    socklen_t addr_len;
+
+    if (server_address(host_ip, portno, &serv_addr, &addr_len) < 0)
+        return -1;
+
+    int sockfd = socket(serv_addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0)
+        return -1;
+
+    // the connect finishes in the background, the socket becomes writable when it's done
+    if (connect(sockfd, (struct sockaddr*) &serv_addr, addr_len) < 0
+        && errno != EINPROGRESS) {
+        close(sockfd);
+        return -1;
+    }
+
+    return sockfd;
+}
+
+void close_connection(int sockfd)
+{
+    close(sockfd);
+}
+
+// checks that the server hasn't closed an idle connection in the meantime
+static int connection_is_alive(int sockfd)
+{
+    char c;
+    ssize_t bytes = recv(sockfd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    // EOF and unsolicited data (like a 408 timeout response) both mean it's unusable
+    if (bytes >= 0)
+        return 0;
+
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+int pool_acquire(char *host_ip, int portno)
+{
+    // prefer the most recently used connection since it's the least likely to be timed out
+    for (int i = idle_count - 1; i >= 0; i--) {
+        if (idle_pool[i].portno != portno || strcmp(idle_pool[i].host, host_ip) != 0)
+            continue;
+
+        int sockfd = idle_pool[i].sockfd;
+
+        memmove(&idle_pool[i], &idle_pool[i + 1], (idle_count - i - 1) * sizeof(pooled_connection));
+        idle_count--;
+
+        if (connection_is_alive(sockfd))
+            return sockfd;
+
+        close_connection(sockfd);
     }
-    buffer_add(&buffer, "", 1);
-    return buffer.data;
+
+    return -1;
 }
 
-char *basic_extract_json_response(char *str)
+void pool_release(int sockfd, char *host_ip, int portno, int reusable)
 {
-    char *ret = strstr(str, "[{");
+    if (!reusable || strlen(host_ip) >= HOST_MAX_LEN) {
+        close_connection(sockfd);
+        return;
+    }
 
-    if (ret == NULL) {
-        return strstr(str, "{\"");
+    // evict the least recently used connection when the pool is full
+    if (idle_count == POOL_MAX_IDLE) {
+        close_connection(idle_pool[0].sockfd);
+        memmove(&idle_pool[0], &idle_pool[1], (idle_count - 1) * sizeof(pooled_connection));
+        idle_count--;
     }
 
-    return ret;
+    idle_pool[idle_count].sockfd = sockfd;
+    idle_pool[idle_count].portno = portno;
+    strcpy(idle_pool[idle_count].host, host_ip);
+    idle_count++;
 }
 
-int count_digits(int x)
+void pool_preconnect(char *host_ip, int portno)
 {
-    int count = 0;
+    for (int i = idle_count - 1; i >= 0; i--) {
+        if (idle_pool[i].portno != portno || strcmp(idle_pool[i].host, host_ip) != 0)
+            continue;
 
-    while (x != 0) {
-        x /= 10;
-        count++;
+        if (connection_is_alive(idle_pool[i].sockfd))
+            return;
+
+        close_connection(idle_pool[i].sockfd);
+        memmove(&idle_pool[i], &idle_pool[i + 1], (idle_count - i - 1) * sizeof(pooled_connection));
+        idle_count--;
     }
 
-    return count;
-}
\ No newline at end of file
+    /* the connect goes on in the background and the socket waits in the pool,
+     * where the next request picks it up (sending on it just waits for the
+     * handshake to finish, and a failed one shows up like a stale connection)
+     */
+    int sockfd = start_connection(host_ip, portno);
+    if (sockfd >= 0)
+        pool_release(sockfd, host_ip, portno, 1);
+}
+
+void pool_destroy(void)
+{
+    for (int i = 0; i < idle_count; i++)
+        close_connection(idle_pool[i].sockfd);
+
+    idle_count = 0;
+}
@@ -1,30 +1,84 @@
 #ifndef _HELPERS_
 #define _HELPERS_
 
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "resolver.h"
+#include "response.h"
+
 #define BUFLEN 4096
 #define LINELEN 1000
+#define POOL_MAX_IDLE 4
+#define HOST_MAX_LEN 256
+#define CONNECT_ATTEMPT_DELAY 250
+#define RACE_PENDING -1
+#define RACE_FAILED -2
+
+/* non-blocking connects to the addresses of a server, each one started
+ * CONNECT_ATTEMPT_DELAY milliseconds after the previous one (or right away if
+ * that one failed), the first to go through wins
+ */
+typedef struct {
+    resolved_address addresses[RESOLVER_MAX_ADDRESSES];
+    int sockfds[RESOLVER_MAX_ADDRESSES];
+    int count;
+    int started;
+    int failed;
+    int socket_type;
+    int protocol;
+    long long next_attempt;
+} connect_race;
 
 // shows the current error
 void error(const char *msg);
 
-// adds a line to a string message
-void compute_message(char *message, const char *line);
+/* resolves host_ip and starts connecting to its first address of family
+ * ip_type, returns -1 if there is nothing that can be connected to
+ */
+int race_start(connect_race *race, char *host_ip, int portno, int ip_type, int socket_type, int protocol);
+
+/* takes over a non-blocking connect to the first address of host_ip that was
+ * started with start_connection, returns -1 if host_ip can't be resolved
+ */
+int race_adopt(connect_race *race, int sockfd, char *host_ip, int portno);
+
+/* collects the attempts that finished and starts the next one when it's due,
+ * returns the connected socket, RACE_PENDING or RACE_FAILED
+ */
+int race_poll(connect_race *race);
+
+// returns the milliseconds until the next attempt is due, -1 if all of them started
+int race_timeout(connect_race *race);
+
+// closes the attempts still in progress
+void race_abort(connect_race *race);
+
+// returns a monotonic timestamp in milliseconds
+long long clock_ms(void);
+
+// fills in the address of server host_ip on port portno, returns -1 if it can't be resolved
+int server_address(char *host_ip, int portno, struct sockaddr_storage *serv_addr, socklen_t *addr_len);
+
+// starts a non-blocking connection with server host_ip on port portno, returns a socket or -1
+int start_connection(char *host_ip, int portno);
 
-// opens a connection with server host_ip on port portno, returns a socket
-int open_connection(char *host_ip, int portno, int ip_type, int socket_type, int flag);
+// returns whether the connect started on socket sockfd hasn't gone through yet
+int connection_is_connecting(int sockfd);
 
 // closes a server connection on socket sockfd
 void close_connection(int sockfd);
 
-// send a message to a server
-void send_to_server(int sockfd, char *message);
+// takes an idle pooled connection to host_ip:portno, returns -1 if there is none
+int pool_acquire(char *host_ip, int portno);
 
-// receives and returns the message from a server
-char *receive_from_server(int sockfd);
+// puts a connection back in the idle pool, or closes it if it can't be reused
+void pool_release(int sockfd, char *host_ip, int portno, int reusable);
 
-// extracts and returns a JSON from a server response
-char *basic_extract_json_response(char *str);
+// starts connecting to host_ip:portno ahead of time unless the pool has a live connection to it
+void pool_preconnect(char *host_ip, int portno);
 
-int count_digits(int x);
+// closes all idle pooled connections
+void pool_destroy(void);
 
 #endif
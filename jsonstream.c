@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jsonstream.h"
+
+void json_stream_init(json_stream *stream, json_stream_callback callback, void *context)
+{
+    stream->callback = callback;
+    stream->context = context;
+    stream->state = JSON_STREAM_EXPECT_VALUE;
+    stream->in_key = 0;
+    stream->escape = 0;
+    stream->unicode_digits = 0;
+    stream->unicode = 0;
+    stream->high_surrogate = 0;
+    stream->depth = 0;
+    stream->token = NULL;
+    stream->token_size = 0;
+    stream->token_capacity = 0;
+}
+
+void json_stream_destroy(json_stream *stream)
+{
+    free(stream->token);
+    stream->token = NULL;
+    stream->token_size = 0;
+    stream->token_capacity = 0;
+}
+
+// adds data to the token being read, keeping room for a terminator
+static void token_add(json_stream *stream, const char *data, size_t size)
+{
+    if (stream->token_size + size + 1 > stream->token_capacity) {
+        size_t capacity = stream->token_capacity ? stream->token_capacity : 64;
+
+        while (stream->token_size + size + 1 > capacity)
+            capacity *= 2;
+
+        stream->token = realloc(stream->token, capacity);
+        if (stream->token == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+
+        stream->token_capacity = capacity;
+    }
+
+    memcpy(stream->token + stream->token_size, data, size);
+    stream->token_size += size;
+}
+
+/* starts a new token with its first character, if it has one, making room
+ * for a terminator either way so that an empty key or string still comes
+ * with a valid buffer
+ */
+static void token_start(json_stream *stream, int state, const char *first)
+{
+    stream->state = state;
+    stream->token_size = 0;
+
+    token_add(stream, first != NULL ? first : "", first != NULL);
+}
+
+static void emit(json_stream *stream, int event)
+{
+    if (stream->token != NULL)
+        stream->token[stream->token_size] = '\0';
+
+    stream->callback(stream->context, event, stream->token, stream->token_size);
+}
+
+// moves on after a whole value, to the rest of its container or the end of the text
+static void value_done(json_stream *stream)
+{
+    stream->state = stream->depth == 0 ? JSON_STREAM_DONE : JSON_STREAM_EXPECT_NEXT;
+}
+
+static void container_begin(json_stream *stream, int is_object)
+{
+    if (stream->depth == JSON_STREAM_MAX_DEPTH) {
+        stream->state = JSON_STREAM_ERROR;
+        return;
+    }
+
+    stream->token_size = 0;
+    emit(stream, is_object ? JSON_STREAM_BEGIN_OBJECT : JSON_STREAM_BEGIN_ARRAY);
+
+    stream->objects[stream->depth++] = is_object;
+    stream->state = is_object ? JSON_STREAM_EXPECT_KEY_OR_END : JSON_STREAM_EXPECT_VALUE_OR_END;
+}
+
+static void container_end(json_stream *stream)
+{
+    int is_object = stream->objects[--stream->depth];
+
+    stream->token_size = 0;
+    emit(stream, is_object ? JSON_STREAM_END_OBJECT : JSON_STREAM_END_ARRAY);
+
+    value_done(stream);
+}
+
+static void number_end(json_stream *stream)
+{
+    char *end;
+
+    stream->token[stream->token_size] = '\0';
+    strtod(stream->token, &end);
+
+    // strtod takes forms JSON doesn't, like "+1" or ".5"
+    if (end != stream->token + stream->token_size || stream->token[0] == '+'
+        || stream->token[stream->token[0] == '-'] == '.') {
+        stream->state = JSON_STREAM_ERROR;
+        return;
+    }
+
+    emit(stream, JSON_STREAM_NUMBER);
+    value_done(stream);
+}
+
+static void literal_end(json_stream *stream)
+{
+    static const char *literals[] = { "true", "false", "null" };
+    static const int events[] = { JSON_STREAM_TRUE, JSON_STREAM_FALSE, JSON_STREAM_NULL };
+
+    for (int i = 0; i < 3; i++) {
+        if (stream->token_size == strlen(literals[i])
+            && memcmp(stream->token, literals[i], stream->token_size) == 0) {
+            stream->token_size = 0;
+            emit(stream, events[i]);
+            value_done(stream);
+            return;
+        }
+    }
+
+    stream->state = JSON_STREAM_ERROR;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+// adds the character of a \uXXXX escape (or of two, for a surrogate pair) as UTF-8
+static void unicode_add(json_stream *stream)
+{
+    unsigned int code = stream->unicode;
+    char utf8[4];
+    size_t size;
+
+    if (code >= 0xD800 && code <= 0xDBFF && stream->high_surrogate == 0) {
+        stream->high_surrogate = code;
+        return;
+    }
+
+    if (stream->high_surrogate != 0) {
+        if (code < 0xDC00 || code > 0xDFFF) {
+            stream->state = JSON_STREAM_ERROR;
+            return;
+        }
+
+        code = 0x10000 + ((stream->high_surrogate - 0xD800) << 10) + (code - 0xDC00);
+        stream->high_surrogate = 0;
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        stream->state = JSON_STREAM_ERROR;
+        return;
+    }
+
+    if (code < 0x80) {
+        utf8[0] = code;
+        size = 1;
+    } else if (code < 0x800) {
+        utf8[0] = 0xC0 | (code >> 6);
+        utf8[1] = 0x80 | (code & 0x3F);
+        size = 2;
+    } else if (code < 0x10000) {
+        utf8[0] = 0xE0 | (code >> 12);
+        utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+        utf8[2] = 0x80 | (code & 0x3F);
+        size = 3;
+    } else {
+        utf8[0] = 0xF0 | (code >> 18);
+        utf8[1] = 0x80 | ((code >> 12) & 0x3F);
+        utf8[2] = 0x80 | ((code >> 6) & 0x3F);
+        utf8[3] = 0x80 | (code & 0x3F);
+        size = 4;
+    }
+
+    token_add(stream, utf8, size);
+}
+
+// adds the character of a one letter escape like \n
+static void escape_add(json_stream *stream, char c)
+{
+    static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+
+    for (int i = 0; escapes[i] != '\0'; i += 2) {
+        if (escapes[i] == c) {
+            token_add(stream, &escapes[i + 1], 1);
+            return;
+        }
+    }
+
+    stream->state = JSON_STREAM_ERROR;
+}
+
+/* reads the inside of a string up to its closing quote, copying runs of plain
+ * characters at once, and returns how many bytes of data it went through
+ */
+static size_t string_read(json_stream *stream, const char *data, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size && stream->state == JSON_STREAM_IN_STRING) {
+        char c = data[i];
+
+        if (stream->unicode_digits > 0) {
+            if (hex_value(c) < 0) {
+                stream->state = JSON_STREAM_ERROR;
+                break;
+            }
+
+            stream->unicode = stream->unicode * 16 + hex_value(c);
+            if (--stream->unicode_digits == 0)
+                unicode_add(stream);
+
+            i++;
+            continue;
+        }
+
+        if (stream->escape) {
+            stream->escape = 0;
+
+            // the second half of a surrogate pair has to come right after the first
+            if (c == 'u') {
+                stream->unicode_digits = 4;
+                stream->unicode = 0;
+            } else if (stream->high_surrogate != 0) {
+                stream->state = JSON_STREAM_ERROR;
+            } else {
+                escape_add(stream, c);
+            }
+
+            i++;
+            continue;
+        }
+
+        if (c == '\\') {
+            stream->escape = 1;
+            i++;
+            continue;
+        }
+
+        if (stream->high_surrogate != 0 || (unsigned char) c < 0x20) {
+            stream->state = JSON_STREAM_ERROR;
+            break;
+        }
+
+        if (c == '"') {
+            if (stream->in_key) {
+                emit(stream, JSON_STREAM_KEY);
+                stream->state = JSON_STREAM_EXPECT_COLON;
+            } else {
+                emit(stream, JSON_STREAM_STRING);
+                value_done(stream);
+            }
+
+            i++;
+            break;
+        }
+
+        size_t run = i + 1;
+        while (run < size && data[run] != '"' && data[run] != '\\'
+               && (unsigned char) data[run] >= 0x20)
+            run++;
+
+        token_add(stream, data + i, run - i);
+        i = run;
+    }
+
+    return i;
+}
+
+// starts whatever value begins with c
+static void value_start(json_stream *stream, char c)
+{
+    if (c == '{') {
+        container_begin(stream, 1);
+    } else if (c == '[') {
+        container_begin(stream, 0);
+    } else if (c == '"') {
+        stream->in_key = 0;
+        token_start(stream, JSON_STREAM_IN_STRING, NULL);
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        token_start(stream, JSON_STREAM_IN_NUMBER, &c);
+    } else if (c >= 'a' && c <= 'z') {
+        token_start(stream, JSON_STREAM_IN_LITERAL, &c);
+    } else {
+        stream->state = JSON_STREAM_ERROR;
+    }
+}
+
+// handles a character between tokens
+static void structure_read(json_stream *stream, char c)
+{
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        return;
+
+    switch (stream->state) {
+    case JSON_STREAM_EXPECT_VALUE_OR_END:
+        if (c == ']') {
+            container_end(stream);
+            break;
+        }
+
+        value_start(stream, c);
+        break;
+    case JSON_STREAM_EXPECT_VALUE:
+        value_start(stream, c);
+        break;
+    case JSON_STREAM_EXPECT_KEY_OR_END:
+        if (c == '}') {
+            container_end(stream);
+            break;
+        }
+        // fall through
+    case JSON_STREAM_EXPECT_KEY:
+        if (c != '"') {
+            stream->state = JSON_STREAM_ERROR;
+            break;
+        }
+
+        stream->in_key = 1;
+        token_start(stream, JSON_STREAM_IN_STRING, NULL);
+        break;
+    case JSON_STREAM_EXPECT_COLON:
+        stream->state = c == ':' ? JSON_STREAM_EXPECT_VALUE : JSON_STREAM_ERROR;
+        break;
+    case JSON_STREAM_EXPECT_NEXT: {
+        int is_object = stream->objects[stream->depth - 1];
+
+        if (c == ',')
+            stream->state = is_object ? JSON_STREAM_EXPECT_KEY : JSON_STREAM_EXPECT_VALUE;
+        else if (c == (is_object ? '}' : ']'))
+            container_end(stream);
+        else
+            stream->state = JSON_STREAM_ERROR;
+
+        break;
+    }
+    default:
+        // nothing but whitespace can follow the value
+        stream->state = JSON_STREAM_ERROR;
+        break;
+    }
+}
+
+int json_stream_feed(json_stream *stream, const char *data, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size && stream->state != JSON_STREAM_ERROR) {
+        char c = data[i];
+
+        switch (stream->state) {
+        case JSON_STREAM_IN_STRING:
+            i += string_read(stream, data + i, size - i);
+            continue;
+        case JSON_STREAM_IN_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                token_add(stream, &c, 1);
+                i++;
+            } else {
+                // the character after the number is read again as structure
+                number_end(stream);
+            }
+
+            continue;
+        case JSON_STREAM_IN_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                token_add(stream, &c, 1);
+                i++;
+            } else {
+                literal_end(stream);
+            }
+
+            continue;
+        default:
+            structure_read(stream, c);
+            i++;
+        }
+    }
+
+    return stream->state == JSON_STREAM_ERROR ? -1 : 0;
+}
+
+int json_stream_finish(json_stream *stream)
+{
+    if (stream->state == JSON_STREAM_IN_NUMBER)
+        number_end(stream);
+    else if (stream->state == JSON_STREAM_IN_LITERAL)
+        literal_end(stream);
+
+    return stream->state == JSON_STREAM_DONE ? 0 : -1;
+}
@@ -0,0 +1,73 @@
+#ifndef _JSONSTREAM_
+#define _JSONSTREAM_
+
+#include <stddef.h>
+
+#define JSON_STREAM_MAX_DEPTH 64
+
+// what a streaming parser reports as it goes through a JSON text
+#define JSON_STREAM_BEGIN_OBJECT 0
+#define JSON_STREAM_END_OBJECT 1
+#define JSON_STREAM_BEGIN_ARRAY 2
+#define JSON_STREAM_END_ARRAY 3
+#define JSON_STREAM_KEY 4
+#define JSON_STREAM_STRING 5
+#define JSON_STREAM_NUMBER 6
+#define JSON_STREAM_TRUE 7
+#define JSON_STREAM_FALSE 8
+#define JSON_STREAM_NULL 9
+
+// what a streaming parser expects next
+#define JSON_STREAM_EXPECT_VALUE 0
+#define JSON_STREAM_EXPECT_VALUE_OR_END 1
+#define JSON_STREAM_EXPECT_KEY 2
+#define JSON_STREAM_EXPECT_KEY_OR_END 3
+#define JSON_STREAM_EXPECT_COLON 4
+#define JSON_STREAM_EXPECT_NEXT 5
+#define JSON_STREAM_IN_STRING 6
+#define JSON_STREAM_IN_NUMBER 7
+#define JSON_STREAM_IN_LITERAL 8
+#define JSON_STREAM_DONE 9
+#define JSON_STREAM_ERROR 10
+
+/* gets every event with the context given to json_stream_init; keys and
+ * strings come unescaped in data (NUL-terminated), numbers as their text,
+ * the other events without data
+ */
+typedef void (*json_stream_callback)(void *context, int event, const char *data, size_t size);
+
+/* a SAX-style JSON parser that is fed a text in pieces of any size and
+ * reports each value as soon as it is complete, so it only ever holds the
+ * token being read and the stack of containers it is in
+ */
+typedef struct {
+    json_stream_callback callback;
+    void *context;
+    int state;
+    int in_key;
+    int escape;
+    int unicode_digits;
+    unsigned int unicode;
+    unsigned int high_surrogate;
+    // how many arrays and objects the current event is inside of
+    int depth;
+    // whether each open container is an object
+    unsigned char objects[JSON_STREAM_MAX_DEPTH];
+    char *token;
+    size_t token_size;
+    size_t token_capacity;
+} json_stream;
+
+// initializes a parser that reports its events to callback
+void json_stream_init(json_stream *stream, json_stream_callback callback, void *context);
+
+// frees what a parser holds
+void json_stream_destroy(json_stream *stream);
+
+// parses the next piece of the text, returns -1 once the text is found to be invalid
+int json_stream_feed(json_stream *stream, const char *data, size_t size);
+
+// tells the parser the text ended, returns -1 if it isn't a whole JSON value
+int json_stream_finish(json_stream *stream);
+
+#endif
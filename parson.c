@@ -61,6 +61,7 @@
 #define strcpy USE_MEMCPY_INSTEAD_OF_STRCPY
 
 #define STARTING_CAPACITY 16
+#define SMALL_OBJECT_CAPACITY 8 /* objects up to this many items are searched linearly */
 #define MAX_NESTING       2048
 
 #ifndef PARSON_DEFAULT_FLOAT_FORMAT
@@ -107,6 +108,9 @@ typedef int parson_bool_t;
 #define PARSON_TRUE 1
 #define PARSON_FALSE 0
 
+/* set while json_parse_string_in_situ runs, strings are then unescaped over the input */
+static parson_bool_t parson_in_situ = PARSON_FALSE;
+
 typedef struct json_string {
     char *chars;
     size_t length;
@@ -116,6 +120,7 @@ typedef struct json_string {
 typedef union json_value_value {
     JSON_String  string;
     double       number;
+    int64_t      integer;
     JSON_Object *object;
     JSON_Array  *array;
     int          boolean;
@@ -125,6 +130,8 @@ typedef union json_value_value {
 struct json_value_t {
     JSON_Value      *parent;
     JSON_Value_Type  type;
+    parson_bool_t    borrowed; /* string chars or object names point into the parsed input */
+    parson_bool_t    is_integer; /* number is held exactly in value.integer */
     JSON_Value_Value value;
 };
 
@@ -137,7 +144,12 @@ struct json_object_t {
     size_t        *cell_ixs;
     size_t         count;
     size_t         item_capacity;
-    size_t         cell_capacity;
+    size_t         cell_capacity; /* 0 while the object is small */
+    /* small objects keep their items here, in the same allocation, and are
+       searched linearly without hashing; the hash table is only built once
+       they outgrow it */
+    char          *small_names[SMALL_OBJECT_CAPACITY];
+    JSON_Value    *small_values[SMALL_OBJECT_CAPACITY];
 };
 
 struct json_array_t {
@@ -192,6 +204,7 @@ static JSON_Value *  parse_array_value(const char **string, size_t nesting);
 static JSON_Value *  parse_string_value(const char **string);
 static JSON_Value *  parse_boolean_value(const char **string);
 static JSON_Value *  parse_number_value(const char **string);
+static JSON_Value *  parse_integer_value(const char **string);
 static JSON_Value *  parse_null_value(const char **string);
 static JSON_Value *  parse_value(const char **string, size_t nesting);
 
@@ -444,6 +457,9 @@ static JSON_Status json_object_init(JSON_Object *object, size_t capacity) {
     object->item_capacity = (unsigned int)(capacity * 0.7f);
 
     if (capacity == 0) {
+        object->names = object->small_names;
+        object->values = object->small_values;
+        object->item_capacity = SMALL_OBJECT_CAPACITY;
         return JSONSuccess;
     }
 
@@ -472,8 +488,19 @@ error:
     return JSONFailure;
 }
 
+static parson_bool_t json_object_is_small(const JSON_Object *object) {
+    return object->cell_capacity == 0;
+}
+
+static parson_bool_t json_object_names_borrowed(const JSON_Object *object) {
+    return object->wrapping_value != NULL && object->wrapping_value->borrowed;
+}
+
 static void json_object_deinit(JSON_Object *object, parson_bool_t free_keys, parson_bool_t free_values) {
     unsigned int i = 0;
+    if (json_object_names_borrowed(object)) {
+        free_keys = PARSON_FALSE;
+    }
     for (i = 0; i < object->count; i++) {
         if (free_keys) {
             parson_free(object->names[i]);
@@ -483,13 +510,16 @@ static void json_object_deinit(JSON_Object *object, parson_bool_t free_keys, par
         }
     }
 
+    if (!json_object_is_small(object)) {
+        parson_free(object->names);
+        parson_free(object->values);
+    }
+
     object->count = 0;
     object->item_capacity = 0;
     object->cell_capacity = 0;
 
     parson_free(object->cells);
-    parson_free(object->names);
-    parson_free(object->values);
     parson_free(object->cell_ixs);
     parson_free(object->hashes);
 
@@ -561,6 +591,16 @@ static size_t json_object_get_cell_ix(const JSON_Object *object, const char *key
     return OBJECT_INVALID_IX;
 }
 
+static size_t json_object_get_small_ix(const JSON_Object *object, const char *key, size_t key_len) {
+    size_t i = 0;
+    for (i = 0; i < object->count; i++) {
+        if (strlen(object->names[i]) == key_len && memcmp(object->names[i], key, key_len) == 0) {
+            return i;
+        }
+    }
+    return OBJECT_INVALID_IX;
+}
+
 static JSON_Status json_object_add(JSON_Object *object, char *name, JSON_Value *value) {
     unsigned long hash = 0;
     parson_bool_t found = PARSON_FALSE;
@@ -571,6 +611,19 @@ static JSON_Status json_object_add(JSON_Object *object, char *name, JSON_Value *
         return JSONFailure;
     }
 
+    if (json_object_is_small(object)) {
+        if (json_object_get_small_ix(object, name, strlen(name)) != OBJECT_INVALID_IX) {
+            return JSONFailure;
+        }
+        if (object->count < object->item_capacity) {
+            object->names[object->count] = name;
+            object->values[object->count] = value;
+            object->count++;
+            value->parent = json_object_get_wrapping_value(object);
+            return JSONSuccess;
+        }
+    }
+
     hash = hash_string(name, strlen(name));
     found = PARSON_FALSE;
     cell_ix = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
@@ -605,6 +658,10 @@ static JSON_Value * json_object_getn_value(const JSON_Object *object, const char
     if (!object || !name) {
         return NULL;
     }
+    if (json_object_is_small(object)) {
+        item_ix = json_object_get_small_ix(object, name, name_len);
+        return item_ix == OBJECT_INVALID_IX ? NULL : object->values[item_ix];
+    }
     hash = hash_string(name, name_len);
     found = PARSON_FALSE;
     cell_ix = json_object_get_cell_ix(object, name, name_len, hash, &found);
@@ -631,22 +688,37 @@ static JSON_Status json_object_remove_internal(JSON_Object *object, const char *
         return JSONFailure;
     }
 
-    hash = hash_string(name, strlen(name));
-    found = PARSON_FALSE;
-    cell = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
-    if (!found) {
-        return JSONFailure;
+    if (json_object_is_small(object)) {
+        item_ix = json_object_get_small_ix(object, name, strlen(name));
+        if (item_ix == OBJECT_INVALID_IX) {
+            return JSONFailure;
+        }
+    } else {
+        hash = hash_string(name, strlen(name));
+        found = PARSON_FALSE;
+        cell = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
+        if (!found) {
+            return JSONFailure;
+        }
+        item_ix = object->cells[cell];
     }
 
-    item_ix = object->cells[cell];
     if (free_value) {
         val = object->values[item_ix];
         json_value_free(val);
         val = NULL;
     }
 
-    parson_free(object->names[item_ix]);
+    if (!json_object_names_borrowed(object)) {
+        parson_free(object->names[item_ix]);
+    }
     last_item_ix = object->count - 1;
+    if (json_object_is_small(object)) {
+        object->names[item_ix] = object->names[last_item_ix];
+        object->values[item_ix] = object->values[last_item_ix];
+        object->count--;
+        return JSONSuccess;
+    }
     if (item_ix < last_item_ix) {
         object->names[item_ix] = object->names[last_item_ix];
         object->values[item_ix] = object->values[last_item_ix];
@@ -756,6 +828,7 @@ static JSON_Value * json_value_init_string_no_copy(char *string, size_t length)
     }
     new_value->parent = NULL;
     new_value->type = JSONString;
+    new_value->borrowed = PARSON_FALSE;
     new_value->value.string.chars = string;
     new_value->value.string.length = length;
     return new_value;
@@ -830,13 +903,19 @@ static JSON_Status parse_utf16(const char **unprocessed, char **processed) {
 
 
 /* Copies and processes passed string up to supplied length.
-Example: "\u006Corem ipsum" -> lorem ipsum */
+Example: "\u006Corem ipsum" -> lorem ipsum
+When parsing in situ the output is written over the input instead, which is
+safe since it never gets ahead of it; the terminator takes the closing quote. */
 static char* process_string(const char *input, size_t input_len, size_t *output_len) {
     const char *input_ptr = input;
     size_t initial_size = (input_len + 1) * sizeof(char);
     size_t final_size = 0;
     char *output = NULL, *output_ptr = NULL, *resized_output = NULL;
-    output = (char*)parson_malloc(initial_size);
+    if (parson_in_situ) {
+        output = (char*)input;
+    } else {
+        output = (char*)parson_malloc(initial_size);
+    }
     if (output == NULL) {
         goto error;
     }
@@ -870,6 +949,10 @@ static char* process_string(const char *input, size_t input_len, size_t *output_
         input_ptr++;
     }
     *output_ptr = '\0';
+    if (parson_in_situ) {
+        *output_len = (size_t)(output_ptr-output);
+        return output;
+    }
     /* resize to new length */
     final_size = (size_t)(output_ptr-output) + 1;
     /* todo: don't resize if final_size == initial_size */
@@ -882,7 +965,9 @@ static char* process_string(const char *input, size_t input_len, size_t *output_
     parson_free(output);
     return resized_output;
 error:
-    parson_free(output);
+    if (!parson_in_situ) {
+        parson_free(output);
+    }
     return NULL;
 }
 
@@ -924,6 +1009,13 @@ static JSON_Value * parse_value(const char **string, size_t nesting) {
     }
 }
 
+/* Frees a string that failed to make it into a value, unless it lives in the input */
+static void free_parsed_string(char *key) {
+    if (!parson_in_situ) {
+        parson_free(key);
+    }
+}
+
 static JSON_Value * parse_object_value(const char **string, size_t nesting) {
     JSON_Status status = JSONFailure;
     JSON_Value *output_value = NULL, *new_value = NULL;
@@ -938,6 +1030,7 @@ static JSON_Value * parse_object_value(const char **string, size_t nesting) {
         json_value_free(output_value);
         return NULL;
     }
+    output_value->borrowed = parson_in_situ;
     output_object = json_value_get_object(output_value);
     SKIP_CHAR(string);
     SKIP_WHITESPACES(string);
@@ -954,26 +1047,26 @@ static JSON_Value * parse_object_value(const char **string, size_t nesting) {
             return NULL;
         }
         if (key_len != strlen(new_key)) {
-            parson_free(new_key);
+            free_parsed_string(new_key);
             json_value_free(output_value);
             return NULL;
         }
         SKIP_WHITESPACES(string);
         if (**string != ':') {
-            parson_free(new_key);
+            free_parsed_string(new_key);
             json_value_free(output_value);
             return NULL;
         }
         SKIP_CHAR(string);
         new_value = parse_value(string, nesting);
         if (new_value == NULL) {
-            parson_free(new_key);
+            free_parsed_string(new_key);
             json_value_free(output_value);
             return NULL;
         }
         status = json_object_add(output_object, new_key, new_value);
         if (status != JSONSuccess) {
-            parson_free(new_key);
+            free_parsed_string(new_key);
             json_value_free(new_value);
             json_value_free(output_value);
             return NULL;
@@ -1055,9 +1148,10 @@ static JSON_Value * parse_string_value(const char **string) {
     }
     value = json_value_init_string_no_copy(new_string, new_string_len);
     if (value == NULL) {
-        parson_free(new_string);
+        free_parsed_string(new_string);
         return NULL;
     }
+    value->borrowed = parson_in_situ;
     return value;
 }
 
@@ -1074,9 +1168,44 @@ static JSON_Value * parse_boolean_value(const char **string) {
     return NULL;
 }
 
+/* Parses plain integers without strtod. Returns NULL, leaving string untouched, for
+   anything it doesn't handle (fractions, exponents, -0, leading zeros, overflow). */
+static JSON_Value * parse_integer_value(const char **string) {
+    const char *p = *string;
+    parson_bool_t negative = PARSON_FALSE;
+    uint64_t limit = INT64_MAX, integer = 0;
+    unsigned digit = 0;
+    if (*p == '-') {
+        negative = PARSON_TRUE;
+        limit = (uint64_t)INT64_MAX + 1;
+        p++;
+    }
+    if (*p < '0' || *p > '9' || (*p == '0' && (negative || (p[1] >= '0' && p[1] <= '9')))) {
+        return NULL;
+    }
+    while (*p >= '0' && *p <= '9') {
+        digit = *p - '0';
+        if (integer > (limit - digit) / 10) {
+            return NULL;
+        }
+        integer = integer * 10 + digit;
+        p++;
+    }
+    if (*p == '.' || *p == 'e' || *p == 'E' || *p == 'x' || *p == 'X') {
+        return NULL;
+    }
+    *string = p;
+    /* -(INT64_MAX + 1) is built without overflowing the signed type */
+    return json_value_init_integer(negative ? -(int64_t)(integer - 1) - 1 : (int64_t)integer);
+}
+
 static JSON_Value * parse_number_value(const char **string) {
     char *end;
     double number = 0;
+    JSON_Value *value = parse_integer_value(string);
+    if (value != NULL) {
+        return value;
+    }
     errno = 0;
     number = strtod(*string, &end);
     if (errno == ERANGE && (number <= -HUGE_VAL || number >= HUGE_VAL)) {
@@ -1121,6 +1250,25 @@ static JSON_Value * parse_null_value(const char **string) {
                                 }\
                             } while (0)
 
+/* Writes an integer's decimal digits and a terminator like sprintf would, returns their count */
+static int serialize_integer(int64_t integer, char *buf) {
+    char digits[20];
+    uint64_t magnitude = integer < 0 ? (uint64_t)0 - (uint64_t)integer : (uint64_t)integer;
+    int count = 0, written = 0;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (integer < 0) {
+        buf[written++] = '-';
+    }
+    while (count > 0) {
+        buf[written++] = digits[--count];
+    }
+    buf[written] = '\0';
+    return written;
+}
+
 static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int level, parson_bool_t is_pretty, char *num_buf)
 {
     const char *key = NULL, *string = NULL;
@@ -1241,7 +1389,9 @@ static int json_serialize_to_buffer_r(const JSON_Value *value, char *buf, int le
             if (buf != NULL) {
                 num_buf = buf;
             }
-            if (parson_number_serialization_function) {
+            if (value->is_integer) {
+                written = serialize_integer(value->value.integer, num_buf);
+            } else if (parson_number_serialization_function) {
                 written = parson_number_serialization_function(num, num_buf);
             } else if (parson_float_format) {
                 written = sprintf(num_buf, parson_float_format, num);
@@ -1369,6 +1519,20 @@ JSON_Value * json_parse_string(const char *string) {
     return parse_value((const char**)&string, 0);
 }
 
+JSON_Value * json_parse_string_in_situ(char *string) {
+    JSON_Value *result = NULL;
+    if (string == NULL) {
+        return NULL;
+    }
+    if (string[0] == '\xEF' && string[1] == '\xBB' && string[2] == '\xBF') {
+        string = string + 3; /* Support for UTF-8 BOM */
+    }
+    parson_in_situ = PARSON_TRUE;
+    result = parse_value((const char**)&string, 0);
+    parson_in_situ = PARSON_FALSE;
+    return result;
+}
+
 JSON_Value * json_parse_string_with_comments(const char *string) {
     JSON_Value *result = NULL;
     char *string_mutable_copy = NULL, *string_mutable_copy_ptr = NULL;
@@ -1405,6 +1569,10 @@ double json_object_get_number(const JSON_Object *object, const char *name) {
     return json_value_get_number(json_object_get_value(object, name));
 }
 
+int64_t json_object_get_integer(const JSON_Object *object, const char *name) {
+    return json_value_get_integer(json_object_get_value(object, name));
+}
+
 JSON_Object * json_object_get_object(const JSON_Object *object, const char *name) {
     return json_value_get_object(json_object_get_value(object, name));
 }
@@ -1438,6 +1606,10 @@ double json_object_dotget_number(const JSON_Object *object, const char *name) {
     return json_value_get_number(json_object_dotget_value(object, name));
 }
 
+int64_t json_object_dotget_integer(const JSON_Object *object, const char *name) {
+    return json_value_get_integer(json_object_dotget_value(object, name));
+}
+
 JSON_Object * json_object_dotget_object(const JSON_Object *object, const char *name) {
     return json_value_get_object(json_object_dotget_value(object, name));
 }
@@ -1513,6 +1685,10 @@ double json_array_get_number(const JSON_Array *array, size_t index) {
     return json_value_get_number(json_array_get_value(array, index));
 }
 
+int64_t json_array_get_integer(const JSON_Array *array, size_t index) {
+    return json_value_get_integer(json_array_get_value(array, index));
+}
+
 JSON_Object * json_array_get_object(const JSON_Array *array, size_t index) {
     return json_value_get_object(json_array_get_value(array, index));
 }
@@ -1564,7 +1740,36 @@ size_t json_value_get_string_len(const JSON_Value *value) {
 }
 
 double json_value_get_number(const JSON_Value *value) {
-    return json_value_get_type(value) == JSONNumber ? value->value.number : 0;
+    if (json_value_get_type(value) != JSONNumber) {
+        return 0;
+    }
+    return value->is_integer ? (double)value->value.integer : value->value.number;
+}
+
+int64_t json_value_get_integer(const JSON_Value *value) {
+    double number;
+    if (json_value_get_type(value) != JSONNumber) {
+        return 0;
+    }
+    if (value->is_integer) {
+        return value->value.integer;
+    }
+    /* casting a double that doesn't fit is undefined, so those are clamped */
+    number = value->value.number;
+    if (number != number) {
+        return 0;
+    }
+    if (number >= 9223372036854775808.0) {
+        return INT64_MAX;
+    }
+    if (number < -9223372036854775808.0) {
+        return INT64_MIN;
+    }
+    return (int64_t)number;
+}
+
+int json_value_is_integer(const JSON_Value *value) {
+    return json_value_get_type(value) == JSONNumber && value->is_integer;
 }
 
 int json_value_get_boolean(const JSON_Value *value) {
@@ -1581,7 +1786,9 @@ void json_value_free(JSON_Value *value) {
             json_object_free(value->value.object);
             break;
         case JSONString:
-            parson_free(value->value.string.chars);
+            if (!value->borrowed) {
+                parson_free(value->value.string.chars);
+            }
             break;
         case JSONArray:
             json_array_free(value->value.array);
@@ -1599,6 +1806,7 @@ JSON_Value * json_value_init_object(void) {
     }
     new_value->parent = NULL;
     new_value->type = JSONObject;
+    new_value->borrowed = PARSON_FALSE;
     new_value->value.object = json_object_make(new_value);
     if (!new_value->value.object) {
         parson_free(new_value);
@@ -1614,6 +1822,7 @@ JSON_Value * json_value_init_array(void) {
     }
     new_value->parent = NULL;
     new_value->type = JSONArray;
+    new_value->borrowed = PARSON_FALSE;
     new_value->value.array = json_array_make(new_value);
     if (!new_value->value.array) {
         parson_free(new_value);
@@ -1660,10 +1869,25 @@ JSON_Value * json_value_init_number(double number) {
     }
     new_value->parent = NULL;
     new_value->type = JSONNumber;
+    new_value->borrowed = PARSON_FALSE;
+    new_value->is_integer = PARSON_FALSE;
     new_value->value.number = number;
     return new_value;
 }
 
+JSON_Value * json_value_init_integer(int64_t integer) {
+    JSON_Value *new_value = (JSON_Value*)parson_malloc(sizeof(JSON_Value));
+    if (new_value == NULL) {
+        return NULL;
+    }
+    new_value->parent = NULL;
+    new_value->type = JSONNumber;
+    new_value->borrowed = PARSON_FALSE;
+    new_value->is_integer = PARSON_TRUE;
+    new_value->value.integer = integer;
+    return new_value;
+}
+
 JSON_Value * json_value_init_boolean(int boolean) {
     JSON_Value *new_value = (JSON_Value*)parson_malloc(sizeof(JSON_Value));
     if (!new_value) {
@@ -1671,6 +1895,7 @@ JSON_Value * json_value_init_boolean(int boolean) {
     }
     new_value->parent = NULL;
     new_value->type = JSONBoolean;
+    new_value->borrowed = PARSON_FALSE;
     new_value->value.boolean = boolean ? 1 : 0;
     return new_value;
 }
@@ -1682,6 +1907,7 @@ JSON_Value * json_value_init_null(void) {
     }
     new_value->parent = NULL;
     new_value->type = JSONNull;
+    new_value->borrowed = PARSON_FALSE;
     return new_value;
 }
 
@@ -1751,6 +1977,9 @@ JSON_Value * json_value_deep_copy(const JSON_Value *value) {
         case JSONBoolean:
             return json_value_init_boolean(json_value_get_boolean(value));
         case JSONNumber:
+            if (value->is_integer) {
+                return json_value_init_integer(value->value.integer);
+            }
             return json_value_init_number(json_value_get_number(value));
         case JSONString:
             temp_string = json_value_get_string_desc(value);
@@ -1957,6 +2186,18 @@ JSON_Status json_array_replace_number(JSON_Array *array, size_t i, double number
     return JSONSuccess;
 }
 
+JSON_Status json_array_replace_integer(JSON_Array *array, size_t i, int64_t integer) {
+    JSON_Value *value = json_value_init_integer(integer);
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (json_array_replace_value(array, i, value) != JSONSuccess) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_array_replace_boolean(JSON_Array *array, size_t i, int boolean) {
     JSON_Value *value = json_value_init_boolean(boolean);
     if (value == NULL) {
@@ -2036,6 +2277,18 @@ JSON_Status json_array_append_number(JSON_Array *array, double number) {
     return JSONSuccess;
 }
 
+JSON_Status json_array_append_integer(JSON_Array *array, int64_t integer) {
+    JSON_Value *value = json_value_init_integer(integer);
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (json_array_append_value(array, value) != JSONSuccess) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_array_append_boolean(JSON_Array *array, int boolean) {
     JSON_Value *value = json_value_init_boolean(boolean);
     if (value == NULL) {
@@ -2071,28 +2324,44 @@ JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Va
     if (!object || !name || !value || value->parent) {
         return JSONFailure;
     }
-    hash = hash_string(name, strlen(name));
-    found = PARSON_FALSE;
-    cell_ix = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
+    if (json_object_is_small(object)) {
+        item_ix = json_object_get_small_ix(object, name, strlen(name));
+        found = item_ix != OBJECT_INVALID_IX;
+    } else {
+        hash = hash_string(name, strlen(name));
+        found = PARSON_FALSE;
+        cell_ix = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
+        item_ix = found ? object->cells[cell_ix] : 0;
+    }
     if (found) {
-        item_ix = object->cells[cell_ix];
         old_value = object->values[item_ix];
         json_value_free(old_value);
         object->values[item_ix] = value;
         value->parent = json_object_get_wrapping_value(object);
         return JSONSuccess;
     }
+    if (json_object_names_borrowed(object)) {
+        return JSONFailure; /* a copied key couldn't be told apart from the borrowed ones */
+    }
     if (object->count >= object->item_capacity) {
         JSON_Status res = json_object_grow_and_rehash(object);
         if (res != JSONSuccess) {
             return JSONFailure;
         }
+        hash = hash_string(name, strlen(name));
         cell_ix = json_object_get_cell_ix(object, name, strlen(name), hash, &found);
     }
     key_copy = parson_strdup(name);
     if (!key_copy) {
         return JSONFailure;
     }
+    if (json_object_is_small(object)) {
+        object->names[object->count] = key_copy;
+        object->values[object->count] = value;
+        object->count++;
+        value->parent = json_object_get_wrapping_value(object);
+        return JSONSuccess;
+    }
     object->names[object->count] = key_copy;
     object->cells[cell_ix] = object->count;
     object->values[object->count] = value;
@@ -2130,6 +2399,15 @@ JSON_Status json_object_set_number(JSON_Object *object, const char *name, double
     return status;
 }
 
+JSON_Status json_object_set_integer(JSON_Object *object, const char *name, int64_t integer) {
+    JSON_Value *value = json_value_init_integer(integer);
+    JSON_Status status = json_object_set_value(object, name, value);
+    if (status != JSONSuccess) {
+        json_value_free(value);
+    }
+    return status;
+}
+
 JSON_Status json_object_set_boolean(JSON_Object *object, const char *name, int boolean) {
     JSON_Value *value = json_value_init_boolean(boolean);
     JSON_Status status = json_object_set_value(object, name, value);
@@ -2235,6 +2513,18 @@ JSON_Status json_object_dotset_number(JSON_Object *object, const char *name, dou
     return JSONSuccess;
 }
 
+JSON_Status json_object_dotset_integer(JSON_Object *object, const char *name, int64_t integer) {
+    JSON_Value *value = json_value_init_integer(integer);
+    if (value == NULL) {
+        return JSONFailure;
+    }
+    if (json_object_dotset_value(object, name, value) != JSONSuccess) {
+        json_value_free(value);
+        return JSONFailure;
+    }
+    return JSONSuccess;
+}
+
 JSON_Status json_object_dotset_boolean(JSON_Object *object, const char *name, int boolean) {
     JSON_Value *value = json_value_init_boolean(boolean);
     if (value == NULL) {
@@ -2273,13 +2563,18 @@ JSON_Status json_object_clear(JSON_Object *object) {
         return JSONFailure;
     }
     for (i = 0; i < json_object_get_count(object); i++) {
-        parson_free(object->names[i]);
+        if (!json_object_names_borrowed(object)) {
+            parson_free(object->names[i]);
+        }
         object->names[i] = NULL;
         
         json_value_free(object->values[i]);
         object->values[i] = NULL;
     }
     object->count = 0;
+    if (object->wrapping_value != NULL) {
+        object->wrapping_value->borrowed = PARSON_FALSE; /* no borrowed keys are left */
+    }
     for (i = 0; i < object->cell_capacity; i++) {
         object->cells[i] = OBJECT_INVALID_IX;
     }
@@ -2401,6 +2696,9 @@ int json_value_equals(const JSON_Value *a, const JSON_Value *b) {
         case JSONBoolean:
             return json_value_get_boolean(a) == json_value_get_boolean(b);
         case JSONNumber:
+            if (a->is_integer && b->is_integer) {
+                return a->value.integer == b->value.integer;
+            }
             return fabs(json_value_get_number(a) - json_value_get_number(b)) < 0.000001; /* EPSILON */
         case JSONError:
             return PARSON_TRUE;
@@ -2435,6 +2733,10 @@ double json_number(const JSON_Value *value) {
     return json_value_get_number(value);
 }
 
+int64_t json_integer(const JSON_Value *value) {
+    return json_value_get_integer(value);
+}
+
 int json_boolean(const JSON_Value *value) {
     return json_value_get_boolean(value);
 }
@@ -41,6 +41,7 @@ extern "C"
 #define PARSON_VERSION_STRING "1.5.1"
 
 #include <stddef.h>   /* size_t */
+#include <stdint.h>   /* int64_t */
 
 /* Types and enums */
 typedef struct json_object_t JSON_Object;
@@ -83,11 +84,13 @@ void json_set_escape_slashes(int escape_slashes);
 
 /* Sets float format used for serialization of numbers.
    Make sure it can't serialize to a string longer than PARSON_NUM_BUF_SIZE.
-   If format is null then the default format is used. */
+   If format is null then the default format is used.
+   Integers (see json_value_init_integer) are always written as plain digits. */
 void json_set_float_serialization_format(const char *format);
 
 /* Sets a function that will be used for serialization of numbers.
-   If function is null then the default serialization function is used. */
+   If function is null then the default serialization function is used.
+   It isn't called for integers. */
 void json_set_number_serialization_function(JSON_Number_Serialization_Function fun);
 
 /* Parses first JSON value in a file, returns NULL in case of error */
@@ -100,6 +103,11 @@ JSON_Value * json_parse_file_with_comments(const char *filename);
 /*  Parses first JSON value in a string, returns NULL in case of error */
 JSON_Value * json_parse_string(const char *string);
 
+/*  Parses first JSON value in a string without copying it: keys and string values
+    are unescaped in place and point into it, so it has to outlive the value.
+    Objects parsed this way can't be given new keys. Returns NULL in case of error */
+JSON_Value * json_parse_string_in_situ(char *string);
+
 /*  Parses first JSON value in a string and ignores comments (/ * * / and //),
     returns NULL in case of error */
 JSON_Value * json_parse_string_with_comments(const char *string);
@@ -142,6 +150,7 @@ size_t        json_object_get_string_len(const JSON_Object *object, const char *
 JSON_Object * json_object_get_object (const JSON_Object *object, const char *name);
 JSON_Array  * json_object_get_array  (const JSON_Object *object, const char *name);
 double        json_object_get_number (const JSON_Object *object, const char *name); /* returns 0 on fail */
+int64_t       json_object_get_integer(const JSON_Object *object, const char *name); /* returns 0 on fail */
 int           json_object_get_boolean(const JSON_Object *object, const char *name); /* returns -1 on fail */
 
 /* dotget functions enable addressing values with dot notation in nested objects,
@@ -154,6 +163,7 @@ size_t        json_object_dotget_string_len(const JSON_Object *object, const cha
 JSON_Object * json_object_dotget_object (const JSON_Object *object, const char *name);
 JSON_Array  * json_object_dotget_array  (const JSON_Object *object, const char *name);
 double        json_object_dotget_number (const JSON_Object *object, const char *name); /* returns 0 on fail */
+int64_t       json_object_dotget_integer(const JSON_Object *object, const char *name); /* returns 0 on fail */
 int           json_object_dotget_boolean(const JSON_Object *object, const char *name); /* returns -1 on fail */
 
 /* Functions to get available names */
@@ -176,6 +186,7 @@ JSON_Status json_object_set_value(JSON_Object *object, const char *name, JSON_Va
 JSON_Status json_object_set_string(JSON_Object *object, const char *name, const char *string);
 JSON_Status json_object_set_string_with_len(JSON_Object *object, const char *name, const char *string, size_t len);  /* length shouldn't include last null character */
 JSON_Status json_object_set_number(JSON_Object *object, const char *name, double number);
+JSON_Status json_object_set_integer(JSON_Object *object, const char *name, int64_t integer);
 JSON_Status json_object_set_boolean(JSON_Object *object, const char *name, int boolean);
 JSON_Status json_object_set_null(JSON_Object *object, const char *name);
 
@@ -185,6 +196,7 @@ JSON_Status json_object_dotset_value(JSON_Object *object, const char *name, JSON
 JSON_Status json_object_dotset_string(JSON_Object *object, const char *name, const char *string);
 JSON_Status json_object_dotset_string_with_len(JSON_Object *object, const char *name, const char *string, size_t len); /* length shouldn't include last null character */
 JSON_Status json_object_dotset_number(JSON_Object *object, const char *name, double number);
+JSON_Status json_object_dotset_integer(JSON_Object *object, const char *name, int64_t integer);
 JSON_Status json_object_dotset_boolean(JSON_Object *object, const char *name, int boolean);
 JSON_Status json_object_dotset_null(JSON_Object *object, const char *name);
 
@@ -206,6 +218,7 @@ size_t        json_array_get_string_len(const JSON_Array *array, size_t index);
 JSON_Object * json_array_get_object (const JSON_Array *array, size_t index);
 JSON_Array  * json_array_get_array  (const JSON_Array *array, size_t index);
 double        json_array_get_number (const JSON_Array *array, size_t index); /* returns 0 on fail */
+int64_t       json_array_get_integer(const JSON_Array *array, size_t index); /* returns 0 on fail */
 int           json_array_get_boolean(const JSON_Array *array, size_t index); /* returns -1 on fail */
 size_t        json_array_get_count  (const JSON_Array *array);
 JSON_Value  * json_array_get_wrapping_value(const JSON_Array *array);
@@ -221,6 +234,7 @@ JSON_Status json_array_replace_value(JSON_Array *array, size_t i, JSON_Value *va
 JSON_Status json_array_replace_string(JSON_Array *array, size_t i, const char* string);
 JSON_Status json_array_replace_string_with_len(JSON_Array *array, size_t i, const char *string, size_t len); /* length shouldn't include last null character */
 JSON_Status json_array_replace_number(JSON_Array *array, size_t i, double number);
+JSON_Status json_array_replace_integer(JSON_Array *array, size_t i, int64_t integer);
 JSON_Status json_array_replace_boolean(JSON_Array *array, size_t i, int boolean);
 JSON_Status json_array_replace_null(JSON_Array *array, size_t i);
 
@@ -233,6 +247,7 @@ JSON_Status json_array_append_value(JSON_Array *array, JSON_Value *value);
 JSON_Status json_array_append_string(JSON_Array *array, const char *string);
 JSON_Status json_array_append_string_with_len(JSON_Array *array, const char *string, size_t len); /* length shouldn't include last null character */
 JSON_Status json_array_append_number(JSON_Array *array, double number);
+JSON_Status json_array_append_integer(JSON_Array *array, int64_t integer);
 JSON_Status json_array_append_boolean(JSON_Array *array, int boolean);
 JSON_Status json_array_append_null(JSON_Array *array);
 
@@ -244,6 +259,7 @@ JSON_Value * json_value_init_array  (void);
 JSON_Value * json_value_init_string (const char *string); /* copies passed string */
 JSON_Value * json_value_init_string_with_len(const char *string, size_t length); /* copies passed string, length shouldn't include last null character */
 JSON_Value * json_value_init_number (double number);
+JSON_Value * json_value_init_integer(int64_t integer); /* kept exactly, serialized without a float format */
 JSON_Value * json_value_init_boolean(int boolean);
 JSON_Value * json_value_init_null   (void);
 JSON_Value * json_value_deep_copy   (const JSON_Value *value);
@@ -255,6 +271,8 @@ JSON_Array  *   json_value_get_array  (const JSON_Value *value);
 const char  *   json_value_get_string (const JSON_Value *value);
 size_t          json_value_get_string_len(const JSON_Value *value); /* doesn't account for last null character */
 double          json_value_get_number (const JSON_Value *value);
+int64_t         json_value_get_integer(const JSON_Value *value); /* truncates numbers that aren't integers, clamps ones out of range */
+int             json_value_is_integer (const JSON_Value *value);
 int             json_value_get_boolean(const JSON_Value *value);
 JSON_Value  *   json_value_get_parent (const JSON_Value *value);
 
@@ -265,6 +283,7 @@ JSON_Array  *   json_array  (const JSON_Value *value);
 const char  *   json_string (const JSON_Value *value);
 size_t          json_string_len(const JSON_Value *value); /* doesn't account for last null character */
 double          json_number (const JSON_Value *value);
+int64_t         json_integer(const JSON_Value *value);
 int             json_boolean(const JSON_Value *value);
 
 #ifdef __cplusplus
@@ -7,229 +7,308 @@
 #include <netdb.h>      /* struct hostent, gethostbyname */
 #include <arpa/inet.h>
 #include "helpers.h"
+#include "builder.h"
 #include "requests.h"
 
-char *compute_delete_request_auth(char *host, char *url, char *query_params,
-                            char **cookies, int cookies_count,
-                            char *auth_token)
+#define CONNECTION_HEADER "Connection: keep-alive\r\n"
+#define CONTENT_LENGTH_NAME "Content-Length: "
+#define COOKIE_NAME "Cookie: "
+#define AUTHORIZATION_NAME "Authorization: Bearer "
+#define REQUEST_PROTOCOL " HTTP/1.1\r\n"
+#define HOST_NAME "Host: "
+#define HOST_DEFAULT_PORT 80
+
+/* checks that spec has what every request needs: a method, a url and either
+ * a host or a session whose lines carry it
+ */
+static int request_spec_is_valid(const request_spec *spec)
 {
-    char *message = calloc(BUFLEN, sizeof(char));
-    char *line = calloc(LINELEN, sizeof(char));
+    return spec->method != NULL && spec->url != NULL
+           && (spec->host != NULL || spec->session != NULL);
+}
 
-    // Step 1: write the method name, URL, request params (if any) and protocol type
-    if (query_params != NULL) {
-        sprintf(line, "DELETE %s?%s HTTP/1.1", url, query_params);
-    } else {
-        sprintf(line, "DELETE %s HTTP/1.1", url);
-    }
+// returns the size of the request line of spec
+static size_t request_line_size(const request_spec *spec)
+{
+    size_t size = strlen(spec->method) + 1 + strlen(spec->url) + strlen(REQUEST_PROTOCOL);
 
-    compute_message(message, line);
+    if (spec->query_params != NULL)
+        size += 1 + strlen(spec->query_params);
 
-    // Step 2: add the host
-    sprintf(line, "Host: %s", host);
-    compute_message(message, line);
-    // Step 3 (optional): add headers and/or cookies, according to the protocol format
-    if (cookies != NULL) {
-        sprintf(line, "Cookie: %s", cookies[0]);
-        for (int i = 1; i < cookies_count; i++) {
-            strcat(line, "; ");
-            strcat(line, cookies[i]);
-        }
+    return size;
+}
 
-        compute_message(message, line);
-    }
+// returns whether host is an IPv6 literal, which has to be put in brackets
+static int host_is_ipv6(const char *host)
+{
+    return host[0] != '[' && strchr(host, ':') != NULL;
+}
 
-    sprintf(line, "Authorization: Bearer %s", auth_token);
-    compute_message(message, line);
+// returns the size of the Host line request_add_host writes
+static size_t request_host_size(const char *host, int portno)
+{
+    size_t size = strlen(HOST_NAME) + strlen(host) + 2;
 
-    // Step 4: add final new line
-    compute_message(message, "");
+    if (host_is_ipv6(host))
+        size += 2;
 
-    free(line);
+    if (portno != 0 && portno != HOST_DEFAULT_PORT)
+        size += 1 + builder_size_digits(portno);
 
-    return message;
+    return size;
 }
 
-char *compute_get_request_auth(char *host, char *url, char *query_params,
-                            char **cookies, int cookies_count,
-                            char *auth_token)
+/* writes the Host line, with an IPv6 literal in brackets and the port unless
+ * it's the default one
+ */
+static void request_add_host(builder *message, const char *host, int portno)
 {
-    char *message = calloc(BUFLEN, sizeof(char));
-    char *line = calloc(LINELEN, sizeof(char));
-
-    // Step 1: write the method name, URL, request params (if any) and protocol type
-    if (query_params != NULL) {
-        sprintf(line, "GET %s?%s HTTP/1.1", url, query_params);
-    } else {
-        sprintf(line, "GET %s HTTP/1.1", url);
+    int ipv6 = host_is_ipv6(host);
+
+    builder_add_string(message, HOST_NAME);
+    if (ipv6)
+        builder_add(message, "[", 1);
+    builder_add_string(message, host);
+    if (ipv6)
+        builder_add(message, "]", 1);
+
+    if (portno != 0 && portno != HOST_DEFAULT_PORT) {
+        builder_add(message, ":", 1);
+        builder_add_size(message, portno);
     }
 
-    compute_message(message, line);
+    builder_add(message, "\r\n", 2);
+}
 
-    // Step 2: add the host
-    sprintf(line, "Host: %s", host);
-    compute_message(message, line);
-    // Step 3 (optional): add headers and/or cookies, according to the protocol format
-    if (cookies != NULL) {
-        sprintf(line, "Cookie: %s", cookies[0]);
-        for (int i = 1; i < cookies_count; i++) {
-            strcat(line, "; ");
-            strcat(line, cookies[i]);
-        }
+// returns the size of the lines request_add_session writes
+static size_t request_session_size(char *host, int portno, char **cookies, int cookies_count,
+                                   char *auth_token)
+{
+    size_t size = request_host_size(host, portno) + strlen(CONNECTION_HEADER);
 
-        compute_message(message, line);
+    if (cookies != NULL && cookies_count > 0) {
+        size += strlen(COOKIE_NAME) + 2 * (cookies_count - 1) + 2;
+        for (int i = 0; i < cookies_count; i++)
+            size += strlen(cookies[i]);
     }
 
-    sprintf(line, "Authorization: Bearer %s", auth_token);
-    compute_message(message, line);
+    if (auth_token != NULL)
+        size += strlen(AUTHORIZATION_NAME) + strlen(auth_token) + 2;
 
-    // Step 4: add final new line
-    compute_message(message, "");
+    return size;
+}
+
+// returns the size of the header block of spec, with the empty line ending it
+static size_t request_headers_size(const request_spec *spec)
+{
+    size_t size;
 
-    free(line);
+    if (spec->session != NULL)
+        size = spec->session->size;
+    else
+        size = request_session_size(spec->host, spec->portno, spec->cookies,
+                                    spec->cookies_count, spec->auth_token);
 
-    return message;
+    if (spec->content_type != NULL) {
+        size += builder_header_size("Content-Type", spec->content_type);
+        size += strlen(CONTENT_LENGTH_NAME) + builder_size_digits(spec->body_size) + 2;
+    }
+
+    for (int i = 0; i < spec->headers_count; i++)
+        size += builder_header_size(spec->headers[i].name, spec->headers[i].value);
+
+    return size + 2;
 }
 
-char *compute_get_request(char *host, char *url, char *query_params,
-                            char **cookies, int cookies_count)
+// writes the request line of spec
+static void request_add_line(builder *message, const request_spec *spec)
 {
-    char *message = calloc(BUFLEN, sizeof(char));
-    char *line = calloc(LINELEN, sizeof(char));
-
     // Step 1: write the method name, URL, request params (if any) and protocol type
-    if (query_params != NULL) {
-        sprintf(line, "GET %s?%s HTTP/1.1", url, query_params);
-    } else {
-        sprintf(line, "GET %s HTTP/1.1", url);
+    builder_add_string(message, spec->method);
+    builder_add(message, " ", 1);
+    builder_add_string(message, spec->url);
+
+    if (spec->query_params != NULL) {
+        builder_add(message, "?", 1);
+        builder_add_string(message, spec->query_params);
     }
 
-    compute_message(message, line);
+    builder_add_string(message, REQUEST_PROTOCOL);
+}
 
+// writes the lines that stay the same for every request of a session
+static void request_add_session(builder *message, char *host, int portno, char **cookies,
+                                int cookies_count, char *auth_token)
+{
     // Step 2: add the host
-    sprintf(line, "Host: %s", host);
-    compute_message(message, line);
-    // Step 3 (optional): add headers and/or cookies, according to the protocol format
+    request_add_host(message, host, portno);
+    builder_add_string(message, CONNECTION_HEADER);
+
+    // Step 3 (optional): add cookies and the authentication token
     if (cookies != NULL && cookies_count > 0) {
-        sprintf(line, "Cookie: %s", cookies[0]);
+        builder_add_string(message, COOKIE_NAME);
+        builder_add_string(message, cookies[0]);
         for (int i = 1; i < cookies_count; i++) {
-            strcat(line, "; ");
-            strcat(line, cookies[i]);
+            builder_add(message, "; ", 2);
+            builder_add_string(message, cookies[i]);
         }
-
-        compute_message(message, line);
+        builder_add(message, "\r\n", 2);
     }
-    // Step 4: add final new line
-    compute_message(message, "");
-
-    free(line);
 
-    return message;
+    if (auth_token != NULL) {
+        builder_add_string(message, AUTHORIZATION_NAME);
+        builder_add_string(message, auth_token);
+        builder_add(message, "\r\n", 2);
+    }
 }
 
-char *compute_post_request(char *host, char *url, char* content_type, char **body_data,
-                            int body_data_fields_count, char **cookies, int cookies_count)
+// writes the header block of spec
+static void request_add_headers(builder *message, const request_spec *spec)
 {
-    char *message = calloc(BUFLEN, sizeof(char));
-    char *line = calloc(LINELEN, sizeof(char));
-    char *body_data_buffer = calloc(LINELEN, sizeof(char));
+    // Steps 2 and 3: copy the session's lines if they were rendered already
+    if (spec->session != NULL)
+        builder_add(message, spec->session->data, spec->session->size);
+    else
+        request_add_session(message, spec->host, spec->portno, spec->cookies,
+                            spec->cookies_count, spec->auth_token);
+
+    // Step 4 (optional): add the headers describing the body, its size is known without looking at it
+    if (spec->content_type != NULL) {
+        builder_add_header(message, "Content-Type", spec->content_type);
+        builder_add_string(message, CONTENT_LENGTH_NAME);
+        builder_add_size(message, spec->body_size);
+        builder_add(message, "\r\n", 2);
+    }
 
-    for (int i = 0; i < body_data_fields_count - 1; i++)
-        compute_message(body_data_buffer, body_data[i]);
+    for (int i = 0; i < spec->headers_count; i++)
+        builder_add_header(message, spec->headers[i].name, spec->headers[i].value);
 
-    strcat(body_data_buffer, body_data[body_data_fields_count - 1]);
+    // Step 5: add new line at end of header
+    builder_add(message, "\r\n", 2);
+}
 
-    // Step 1: write the method name, URL and protocol type
-    sprintf(line, "POST %s HTTP/1.1", url);
-    compute_message(message, line);
+/* builds the request line and header block of spec in one allocation, with
+ * room for body_reserve more bytes after them
+ */
+static request request_build(const request_spec *spec, size_t body_reserve)
+{
+    request request = { 0 };
+    builder message;
 
-    // Step 2: add the host
-    sprintf(line, "Host: %s", host);
-    compute_message(message, line);
+    if (!request_spec_is_valid(spec))
+        return request;
 
-    /* Step 3: add necessary headers (Content-Type and Content-Length are mandatory)
-            in order to write Content-Length you must first compute the message size
-    */
-    sprintf(line, "Content-Type: %s", content_type);
-    compute_message(message, line);
+    size_t line_size = request_line_size(spec);
 
-    sprintf(line, "Content-Length: %ld", strlen(body_data_buffer));
-    compute_message(message, line);
+    builder_init(&message, line_size + request_headers_size(spec) + body_reserve);
+    request_add_line(&message, spec);
+    request_add_headers(&message, spec);
 
-    // Step 4 (optional): add cookies
-    if (cookies != NULL) {
-        sprintf(line, "Cookie: %s", cookies[0]);
-        for (int i = 1; i < cookies_count; i++) {
-            strcat(line, "; ");
-            strcat(line, cookies[i]);
-        }
-        compute_message(message, line);
-    }
+    request.iov[REQUEST_LINE].iov_base = message.data;
+    request.iov[REQUEST_LINE].iov_len = line_size;
+    request.iov[REQUEST_HEADERS].iov_base = message.data + line_size;
+    request.iov[REQUEST_HEADERS].iov_len = message.size - line_size;
+    request.data = builder_release(&message);
+
+    return request;
+}
 
+char *compute_request(const request_spec *spec, const char *body)
+{
+    builder message;
+    size_t body_size = body != NULL ? spec->body_size : 0;
 
-    // Step 5: add new line at end of header
-    compute_message(message, "");
+    if (!request_spec_is_valid(spec))
+        return NULL;
 
-    // Step 6: add the actual payload data
-    compute_message(message, body_data_buffer);
+    builder_init(&message, request_line_size(spec) + request_headers_size(spec) + body_size);
+    request_add_line(&message, spec);
+    request_add_headers(&message, spec);
 
-    free(line);
-    free(body_data_buffer);
+    /* Step 6: add the actual payload data, without a trailing new line since
+            that would be read as the start of the next request on a kept-alive connection
+    */
+    if (body != NULL)
+        builder_add(&message, body, body_size);
 
-    return message;
+    return builder_release(&message);
 }
 
-char *compute_post_request_auth(char *host, char *url, char* content_type,
-                            char **body_data, int body_data_fields_count,
-                            char **cookies, int cookies_count, char *auth_token)
+request compute_request_json(const request_spec *spec, const JSON_Value *body)
 {
-    char *message = calloc(BUFLEN, sizeof(char));
-    char *line = calloc(LINELEN, sizeof(char));
-    char *body_data_buffer = calloc(LINELEN, sizeof(char));
+    request_spec json_spec = *spec;
 
-    for (int i = 0; i < body_data_fields_count - 1; i++)
-        compute_message(body_data_buffer, body_data[i]);
+    // the serialized size counts the terminator, which isn't sent
+    size_t body_size = json_serialization_size(body);
 
-    strcat(body_data_buffer, body_data[body_data_fields_count - 1]);
+    // a value that can't be serialized doesn't make a request at all
+    if (body_size == 0) {
+        request request = { 0 };
+        return request;
+    }
 
-    // Step 1: write the method name, URL and protocol type
-    sprintf(line, "POST %s HTTP/1.1", url);
-    compute_message(message, line);
+    json_spec.content_type = "application/json";
+    json_spec.body_size = body_size - 1;
 
-    // Step 2: add the host
-    sprintf(line, "Host: %s", host);
-    compute_message(message, line);
+    request request = request_build(&json_spec, body_size);
+    if (request.data == NULL)
+        return request;
 
-    /* Step 3: add necessary headers (Content-Type and Content-Length are mandatory)
-            in order to write Content-Length you must first compute the message size
+    char *body_data = request.data + request.iov[REQUEST_LINE].iov_len
+                      + request.iov[REQUEST_HEADERS].iov_len;
+
+    /* Step 6: serialize the payload right after the headers, in compact form;
+            Content-Length is already sent, so a body that doesn't match it fails the request
     */
-    sprintf(line, "Content-Type: %s", content_type);
-    compute_message(message, line);
+    if (json_serialize_to_buffer(body, body_data, body_size) != JSONSuccess) {
+        request_destroy(&request);
+        memset(request.iov, 0, sizeof(request.iov));
+        return request;
+    }
 
-    sprintf(line, "Content-Length: %ld", strlen(body_data_buffer));
-    compute_message(message, line);
+    request.iov[REQUEST_BODY].iov_base = body_data;
+    request.iov[REQUEST_BODY].iov_len = body_size - 1;
 
-    // Step 4 (optional): add cookies and headers
-    if (cookies != NULL) {
-        sprintf(line, "Cookie: %s", cookies[0]);
-        for (int i = 1; i < cookies_count; i++) {
-            strcat(line, "; ");
-            strcat(line, cookies[i]);
-        }
-        compute_message(message, line);
-    }
+    return request;
+}
 
-    sprintf(line, "Authorization: Bearer %s", auth_token);
-    compute_message(message, line);
+request compute_post_request_json(char *host, int portno, char *url, const JSON_Value *body,
+                            char **cookies, int cookies_count, char *auth_token)
+{
+    request_spec spec = {
+        .method = "POST", .host = host, .portno = portno, .url = url,
+        .cookies = cookies, .cookies_count = cookies_count, .auth_token = auth_token,
+    };
 
-    // Step 5: add new line at end of header
-    compute_message(message, "");
+    return compute_request_json(&spec, body);
+}
 
-    // Step 6: add the actual payload data
-    compute_message(message, body_data_buffer);
+void session_headers_update(session_headers *session, char *host, int portno,
+                            const char *cookie_header, char *auth_token)
+{
+    builder lines;
 
-    free(line);
-    free(body_data_buffer);
+    // the cookies are already joined, so they are sent as a single one
+    char *cookies = (char *) cookie_header;
+    int cookies_count = cookie_header != NULL;
 
-    return message;
-}
\ No newline at end of file
+    builder_init(&lines, request_session_size(host, portno, &cookies, cookies_count, auth_token));
+    request_add_session(&lines, host, portno, &cookies, cookies_count, auth_token);
+
+    free(session->data);
+    session->size = lines.size;
+    session->data = builder_release(&lines);
+}
+
+void session_headers_destroy(session_headers *session)
+{
+    free(session->data);
+    session->data = NULL;
+    session->size = 0;
+}
+
+void request_destroy(request *request)
+{
+    free(request->data);
+    request->data = NULL;
+}
@@ -1,24 +1,91 @@
 #ifndef _REQUESTS_
 #define _REQUESTS_
 
-// computes and returns a GET request string (query_params
-// and cookies can be set to NULL if not needed)
-char *compute_get_request(char *host, char *url, char *query_params,
-							char **cookies, int cookies_count);
+#include <stddef.h>
+#include <sys/uio.h>
+#include "parson.h"
 
-// computes and returns a POST request string (cookies can be NULL if not needed)
-char *compute_post_request(char *host, char *url, char* content_type, char **body_data,
-							int body_data_fields_count, char** cookies, int cookies_count);
+// pieces of a request that are sent together with writev
+#define REQUEST_LINE 0
+#define REQUEST_HEADERS 1
+#define REQUEST_BODY 2
+#define REQUEST_PARTS 3
 
-char *compute_get_request_auth(char *host, char *url, char *query_params,
-                            char **cookies, int cookies_count,
-                            char *auth_token);
+/* a request kept as separate pieces (request line, header block and body)
+ * so that the body never has to be copied next to the headers, the line and
+ * the headers share one allocation
+ */
+typedef struct {
+    char *data;
+    struct iovec iov[REQUEST_PARTS];
+} request;
 
-char *compute_post_request_auth(char *host, char *url, char* content_type,
-                            char **body_data, int body_data_fields_count,
+// a header sent on top of the ones a request gets from its other fields
+typedef struct {
+    const char *name;
+    const char *value;
+} request_header;
+
+/* the header lines a session sends with every request (Host, Connection,
+ * Cookie and Authorization), rendered once whenever the session changes
+ * instead of on every request
+ */
+typedef struct {
+    char *data;
+    size_t size;
+} session_headers;
+
+/* what a request is made of, the fields after url can be NULL (or 0) if not
+ * needed, Content-Type and Content-Length are only sent with a content_type;
+ * Host has host, in brackets if it's an IPv6 literal, and portno unless it's
+ * 0 or 80; with a session, its rendered lines are copied in and host, portno,
+ * cookies and auth_token are ignored
+ */
+typedef struct {
+    const char *method;
+    char *host;
+    int portno;
+    char *url;
+    char *query_params;
+    char *content_type;
+    size_t body_size;
+    char **cookies;
+    int cookies_count;
+    char *auth_token;
+    const request_header *headers;
+    int headers_count;
+    const session_headers *session;
+} request_spec;
+
+/* renders the header lines of a session, replacing the ones rendered before,
+ * cookie_header being the value of its Cookie header (NULL without cookies)
+ */
+void session_headers_update(session_headers *session, char *host, int portno,
+                            const char *cookie_header, char *auth_token);
+
+// frees the rendered header lines of a session
+void session_headers_destroy(session_headers *session);
+
+/* computes and returns a request string followed by the spec's body_size
+ * bytes of body, which can be NULL without a body; its size is computed
+ * first, so it is built in a single allocation
+ * NOTE: returns NULL if the spec has no method, url or host (or session)
+ */
+char *compute_request(const request_spec *spec, const char *body);
+
+/* computes a request whose body is body serialized as compact JSON, written
+ * right after the header block, the spec's content type and body size are
+ * filled in; a spec compute_request would refuse, or a body that can't be
+ * serialized, gives a request whose data is NULL
+ */
+request compute_request_json(const request_spec *spec, const JSON_Value *body);
+
+/* computes a POST request whose body is body serialized as compact JSON,
+ * written right after the header block without an intermediate string
+ */
+request compute_post_request_json(char *host, int portno, char *url, const JSON_Value *body,
                             char **cookies, int cookies_count, char *auth_token);
 
-char *compute_delete_request_auth(char *host, char *url, char *query_params,
-                            char **cookies, int cookies_count,
-                            char *auth_token);
+// frees the request line, header block and body of a request
+void request_destroy(request *request);
 #endif
@@ -0,0 +1,136 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <netdb.h>
+#include "resolver.h"
+#include "helpers.h"
+
+// the answer for one host:port and the moment it stops being valid
+typedef struct {
+    char host[HOST_MAX_LEN];
+    int portno;
+    resolved_address addresses[RESOLVER_MAX_ADDRESSES];
+    int count;
+    time_t expires;
+} resolver_entry;
+
+static resolver_entry cache[RESOLVER_CACHE_SIZE];
+static int cache_count;
+
+static time_t now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+/* getaddrinfo doesn't pass on the record TTLs, so every answer is kept for
+ * the same amount of time, which can be changed from the environment
+ */
+static time_t resolver_ttl(void)
+{
+    static time_t ttl = -1;
+
+    if (ttl < 0) {
+        char *value = getenv(RESOLVER_TTL_ENV);
+        ttl = value != NULL ? atol(value) : RESOLVER_DEFAULT_TTL;
+        if (ttl < 0)
+            ttl = 0;
+    }
+
+    return ttl;
+}
+
+static resolver_entry *cache_find(char *host, int portno)
+{
+    for (int i = 0; i < cache_count; i++)
+        if (cache[i].portno == portno && strcmp(cache[i].host, host) == 0)
+            return &cache[i];
+
+    return NULL;
+}
+
+// picks the slot for a new answer, taking over the one that expires first when full
+static resolver_entry *cache_slot(void)
+{
+    if (cache_count < RESOLVER_CACHE_SIZE)
+        return &cache[cache_count++];
+
+    resolver_entry *oldest = &cache[0];
+    for (int i = 1; i < cache_count; i++)
+        if (cache[i].expires < oldest->expires)
+            oldest = &cache[i];
+
+    return oldest;
+}
+
+// asks the system resolver for host, returns the number of addresses or -1
+static int lookup(char *host, int portno, resolved_address *addresses)
+{
+    struct addrinfo hints, *result, *info;
+    char service[16];
+    int count = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG | AI_NUMERICSERV;
+    sprintf(service, "%d", portno);
+
+    if (getaddrinfo(host, service, &hints, &result) != 0)
+        return -1;
+
+    for (info = result; info != NULL && count < RESOLVER_MAX_ADDRESSES; info = info->ai_next) {
+        if (info->ai_addrlen > sizeof(struct sockaddr_storage))
+            continue;
+
+        memcpy(&addresses[count].addr, info->ai_addr, info->ai_addrlen);
+        addresses[count].addr_len = info->ai_addrlen;
+        count++;
+    }
+
+    freeaddrinfo(result);
+
+    return count > 0 ? count : -1;
+}
+
+int resolve_host(char *host, int portno, resolved_address *addresses, int max)
+{
+    if (strlen(host) >= HOST_MAX_LEN)
+        return -1;
+
+    resolver_entry *entry = cache_find(host, portno);
+
+    if (entry == NULL || entry->expires <= now()) {
+        resolved_address found[RESOLVER_MAX_ADDRESSES];
+        int count = lookup(host, portno, found);
+
+        // failed lookups aren't cached, the next command asks again
+        if (count < 0)
+            return -1;
+
+        if (entry == NULL)
+            entry = cache_slot();
+
+        strcpy(entry->host, host);
+        entry->portno = portno;
+        memcpy(entry->addresses, found, count * sizeof(resolved_address));
+        entry->count = count;
+        entry->expires = now() + resolver_ttl();
+    }
+
+    int count = entry->count < max ? entry->count : max;
+    memcpy(addresses, entry->addresses, count * sizeof(resolved_address));
+
+    return count;
+}
+
+void resolver_forget(char *host, int portno)
+{
+    resolver_entry *entry = cache_find(host, portno);
+
+    if (entry != NULL)
+        *entry = cache[--cache_count];
+}
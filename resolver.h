@@ -0,0 +1,28 @@
+#ifndef _RESOLVER_
+#define _RESOLVER_
+
+#include <sys/socket.h>
+
+#define RESOLVER_MAX_ADDRESSES 8
+#define RESOLVER_CACHE_SIZE 16
+#define RESOLVER_DEFAULT_TTL 60
+#define RESOLVER_TTL_ENV "RESOLVER_TTL"
+
+// one IPv4 or IPv6 address a server can be reached at
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+} resolved_address;
+
+/* resolves host (a name or an IPv4/IPv6 literal) on port portno into at most
+ * max addresses, in the order they should be tried, returns how many were
+ * found or -1 if the host can't be resolved
+ * NOTE: answers are cached for RESOLVER_TTL seconds, so repeated commands
+ * don't go through the resolver again
+ */
+int resolve_host(char *host, int portno, resolved_address *addresses, int max);
+
+// drops the cached addresses of host:portno, e.g. when none of them answered
+void resolver_forget(char *host, int portno);
+
+#endif
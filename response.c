@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
+#include "response.h"
+
+void response_init(response *response)
+{
+    response->raw = buffer_init();
+    response->state = RESPONSE_HEADERS;
+    response->line_start = 0;
+    response->header_end = 0;
+    response->total = 0;
+    response->keep_alive = 0;
+    response->status_code = 0;
+    response->reason = 0;
+    response->reason_size = 0;
+    response->headers = NULL;
+    response->header_count = 0;
+    response->header_capacity = 0;
+    response->chunk_state = CHUNK_SIZE;
+    response->chunk_left = 0;
+    response->chunk_digits = 0;
+    response->body_size = 0;
+    response->streaming = 0;
+    response->on_body = NULL;
+    response->body_context = NULL;
+}
+
+void response_destroy(response *response)
+{
+    buffer_destroy(&response->raw);
+    free(response->headers);
+    response_init(response);
+}
+
+void response_reset(response *response)
+{
+    response_body_callback on_body = response->on_body;
+    void *context = response->body_context;
+
+    response_destroy(response);
+    response_stream_body(response, on_body, context);
+}
+
+void response_stream_body(response *response, response_body_callback on_body, void *context)
+{
+    response->on_body = on_body;
+    response->body_context = context;
+}
+
+const char *response_header_value(response *response, const char *name, size_t *value_size)
+{
+    int index = 0;
+
+    return response_next_header_value(response, name, &index, value_size);
+}
+
+const char *response_next_header_value(response *response, const char *name, int *index,
+                                       size_t *value_size)
+{
+    size_t name_size = strlen(name);
+
+    for (; *index < response->header_count; (*index)++) {
+        response_header *header = &response->headers[*index];
+
+        if (header->name_size == name_size
+            && strncasecmp(response->raw.data + header->name, name, name_size) == 0) {
+            (*index)++;
+            *value_size = header->value_size;
+            return response->raw.data + header->value;
+        }
+    }
+
+    return NULL;
+}
+
+// checks if a comma separated header value lists token, in any case
+static int header_has_token(response *response, const char *name, const char *token)
+{
+    size_t token_size = strlen(token);
+    size_t value_size;
+    const char *value = response_header_value(response, name, &value_size);
+
+    if (value == NULL)
+        return 0;
+
+    const char *end = value + value_size;
+
+    while (value != NULL && value < end) {
+        const char *comma = memchr(value, ',', end - value);
+        const char *stop = comma != NULL ? comma : end;
+
+        while (value < stop && (*value == ' ' || *value == '\t'))
+            value++;
+
+        size_t size = stop - value;
+        while (size > 0 && (value[size - 1] == ' ' || value[size - 1] == '\t'))
+            size--;
+
+        if (size == token_size && strncasecmp(value, token, token_size) == 0)
+            return 1;
+
+        value = comma != NULL ? comma + 1 : NULL;
+    }
+
+    return 0;
+}
+
+// parses "HTTP/1.1 200 OK" from start to stop in the raw response
+static void parse_status_line(response *response, size_t start, size_t stop)
+{
+    const char *line = response->raw.data + start;
+    size_t size = stop - start;
+    const char *space = memchr(line, ' ', size);
+
+    if (size < STATUS_LINE_PREFIX_SIZE || memcmp(line, STATUS_LINE_PREFIX, STATUS_LINE_PREFIX_SIZE) != 0
+        || space == NULL || line + size - space < 4 || !isdigit(space[1]) || !isdigit(space[2])
+        || !isdigit(space[3]) || (line + size - space > 4 && space[4] != ' ')) {
+        response->state = RESPONSE_INVALID;
+        return;
+    }
+
+    response->status_code = (space[1] - '0') * 100 + (space[2] - '0') * 10 + (space[3] - '0');
+
+    // the reason phrase is optional
+    response->reason = space - response->raw.data + 4;
+    if (response->reason < stop)
+        response->reason++;
+
+    response->reason_size = stop - response->reason;
+}
+
+// adds the "Name: value" header line from start to stop to the header table
+static void parse_header_line(response *response, size_t start, size_t stop)
+{
+    const char *line = response->raw.data + start;
+    const char *colon = memchr(line, ':', stop - start);
+
+    if (colon == NULL || colon == line || response->header_count == RESPONSE_MAX_HEADERS) {
+        response->state = RESPONSE_INVALID;
+        return;
+    }
+
+    if (response->header_count == response->header_capacity) {
+        response->header_capacity = response->header_capacity ? 2 * response->header_capacity : 16;
+        response->headers = realloc(response->headers,
+                                    response->header_capacity * sizeof(response_header));
+        if (response->headers == NULL) {
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    response_header *header = &response->headers[response->header_count++];
+    size_t value = colon - response->raw.data + 1;
+
+    // the value doesn't include the whitespace around it
+    while (value < stop && (response->raw.data[value] == ' ' || response->raw.data[value] == '\t'))
+        value++;
+
+    while (stop > value && (response->raw.data[stop - 1] == ' ' || response->raw.data[stop - 1] == '\t'))
+        stop--;
+
+    header->name = start;
+    header->name_size = colon - line;
+    header->value = value;
+    header->value_size = stop - value;
+}
+
+// decides how the body is delimited, once the whole header block is in
+static void parse_framing(response *response)
+{
+    size_t size;
+    const char *content_length = response_header_value(response, "Content-Length", &size);
+
+    response->keep_alive = !header_has_token(response, "Connection", "close");
+    response->streaming = response->on_body != NULL && response_is_success(response);
+
+    // these never have a body, whatever their headers say
+    if (response->status_code == 204 || response->status_code == 304) {
+        response->total = response->header_end;
+        response->state = RESPONSE_BODY;
+        return;
+    }
+
+    // a chunked encoding takes precedence over any Content-Length
+    if (header_has_token(response, "Transfer-Encoding", "chunked")) {
+        response->state = RESPONSE_CHUNKED;
+        return;
+    }
+
+    // without a Content-Length the body lasts until the server closes the connection
+    if (content_length == NULL) {
+        response->keep_alive = 0;
+        response->state = RESPONSE_UNTIL_CLOSE;
+        return;
+    }
+
+    size_t length = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        if (!isdigit(content_length[i]) || length > (SIZE_MAX - 9) / 10) {
+            response->state = RESPONSE_INVALID;
+            return;
+        }
+
+        length = length * 10 + (content_length[i] - '0');
+    }
+
+    if (size == 0) {
+        response->state = RESPONSE_INVALID;
+        return;
+    }
+
+    response->total = response->header_end + length;
+    response->state = RESPONSE_BODY;
+}
+
+/* parses the header lines completed by the bytes added to the raw response
+ * from offset on, so every byte of the header block is looked at only once
+ */
+static void parse_headers(response *response, size_t offset)
+{
+    buffer *raw = &response->raw;
+
+    while (response->state == RESPONSE_HEADERS && offset < raw->size) {
+        int line_feed = buffer_find_newline(raw, offset);
+
+        if (line_feed < 0)
+            return;
+
+        size_t start = response->line_start;
+        size_t stop = line_feed;
+
+        offset = stop + 1;
+        response->line_start = offset;
+
+        if (stop > start && raw->data[stop - 1] == '\r')
+            stop--;
+
+        if (response->status_code == 0) {
+            parse_status_line(response, start, stop);
+        } else if (stop == start) {
+            // an empty line ends the header block
+            response->header_end = offset;
+            parse_framing(response);
+        } else {
+            parse_header_line(response, start, stop);
+        }
+    }
+}
+
+// returns the value of a hex digit or -1 if c isn't one
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+
+    c = tolower(c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+
+    return -1;
+}
+
+// adds a piece of plain body to the response, or hands it to on_body
+static void body_add(response *response, const char *data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    if (response->streaming)
+        response->on_body(response, data, size, response->body_context);
+    else
+        buffer_add(&response->raw, data, size);
+
+    response->body_size += size;
+}
+
+/* decodes the chunks in data straight into the body of the response and
+ * returns how many bytes were part of the chunked body
+ */
+static size_t decode_chunks(response *response, const char *data, size_t size)
+{
+    size_t i = 0;
+
+    while (i < size && response->state == RESPONSE_CHUNKED) {
+        char c = data[i];
+
+        switch (response->chunk_state) {
+        case CHUNK_SIZE:
+            if (hex_value(c) >= 0 && response->chunk_digits < CHUNK_SIZE_MAX_DIGITS) {
+                response->chunk_left = response->chunk_left * 16 + hex_value(c);
+                response->chunk_digits++;
+                break;
+            }
+
+            if (response->chunk_digits == 0 || (c != ';' && c != ' ' && c != '\t'
+                                                && c != '\r' && c != '\n')) {
+                response->state = RESPONSE_INVALID;
+                break;
+            }
+
+            response->chunk_state = CHUNK_EXTENSION;
+            continue;
+        case CHUNK_EXTENSION:
+            // chunk extensions are ignored, the data starts on the next line
+            if (c != '\n')
+                break;
+
+            response->chunk_state = response->chunk_left > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+            break;
+        case CHUNK_DATA: {
+            size_t n = size - i < response->chunk_left ? size - i : response->chunk_left;
+
+            body_add(response, data + i, n);
+            response->chunk_left -= n;
+            i += n;
+
+            if (response->chunk_left == 0)
+                response->chunk_state = CHUNK_DATA_END;
+
+            continue;
+        }
+        case CHUNK_DATA_END:
+            if (c == '\n') {
+                response->chunk_state = CHUNK_SIZE;
+                response->chunk_digits = 0;
+            } else if (c != '\r') {
+                response->state = RESPONSE_INVALID;
+            }
+
+            break;
+        case CHUNK_TRAILER:
+            // the body ends with an empty line after the trailer fields
+            if (c == '\n')
+                response->state = RESPONSE_DONE;
+            else if (c != '\r')
+                response->chunk_state = CHUNK_TRAILER_LINE;
+
+            break;
+        case CHUNK_TRAILER_LINE:
+            if (c == '\n')
+                response->chunk_state = CHUNK_TRAILER;
+
+            break;
+        }
+
+        i++;
+    }
+
+    return i;
+}
+
+size_t response_feed(response *response, const char *data, size_t size)
+{
+    size_t header_size = 0;
+
+    if (response->state == RESPONSE_DONE || response->state == RESPONSE_INVALID)
+        return 0;
+
+    if (response->state == RESPONSE_HEADERS) {
+        size_t old_size = response->raw.size;
+
+        buffer_add(&response->raw, data, size);
+        parse_headers(response, old_size);
+
+        if (response->state == RESPONSE_HEADERS || response->state == RESPONSE_INVALID)
+            return size;
+
+        // whatever came after the headers goes through the body like the rest of it
+        header_size = response->header_end - old_size;
+        response->raw.size = response->header_end;
+        data += header_size;
+        size -= header_size;
+    }
+
+    if (response->state == RESPONSE_CHUNKED)
+        return header_size + decode_chunks(response, data, size);
+
+    // anything past the end of the body is the start of the next response
+    if (response->state == RESPONSE_BODY) {
+        size_t left = response->total - response->header_end - response->body_size;
+
+        if (size > left)
+            size = left;
+    }
+
+    body_add(response, data, size);
+
+    if (response->state == RESPONSE_BODY && response->header_end + response->body_size == response->total)
+        response->state = RESPONSE_DONE;
+
+    return header_size + size;
+}
+
+int response_finish(response *response)
+{
+    if (response->state == RESPONSE_UNTIL_CLOSE)
+        response->state = RESPONSE_DONE;
+
+    response->keep_alive = 0;
+
+    return response->state == RESPONSE_DONE;
+}
+
+int response_is_complete(response *response)
+{
+    return response->state == RESPONSE_DONE;
+}
+
+int response_is_invalid(response *response)
+{
+    return response->state == RESPONSE_INVALID;
+}
+
+int response_is_success(response *response)
+{
+    return response->status_code >= 200 && response->status_code < 300;
+}
+
+char *response_body(response *response, size_t *body_size)
+{
+    if (body_size != NULL)
+        *body_size = response->raw.size - response->header_end;
+
+    return response->raw.data + response->header_end;
+}
+
+response *response_detach(response *received)
+{
+    response *detached = malloc(sizeof(response));
+    if (detached == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    // the terminator comes after the body without being counted in it
+    buffer_add(&received->raw, "", 1);
+    received->raw.size--;
+
+    *detached = *received;
+    response_init(received);
+
+    return detached;
+}
+
+void response_free(response *response)
+{
+    if (response == NULL)
+        return;
+
+    response_destroy(response);
+    free(response);
+}
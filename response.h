@@ -0,0 +1,128 @@
+#ifndef _RESPONSE_
+#define _RESPONSE_
+
+#include "buffer.h"
+
+#define STATUS_LINE_PREFIX "HTTP/"
+#define STATUS_LINE_PREFIX_SIZE (sizeof(STATUS_LINE_PREFIX) - 1)
+#define RESPONSE_MAX_HEADERS 128
+
+// framing states of a response being received
+#define RESPONSE_HEADERS 0
+#define RESPONSE_BODY 1
+#define RESPONSE_UNTIL_CLOSE 2
+#define RESPONSE_CHUNKED 3
+#define RESPONSE_DONE 4
+#define RESPONSE_INVALID 5
+
+// states of the decoder of a chunked body
+#define CHUNK_SIZE 0
+#define CHUNK_EXTENSION 1
+#define CHUNK_DATA 2
+#define CHUNK_DATA_END 3
+#define CHUNK_TRAILER 4
+#define CHUNK_TRAILER_LINE 5
+
+// hex digits of a chunk size that still fit in a size_t
+#define CHUNK_SIZE_MAX_DIGITS (2 * sizeof(size_t) - 1)
+
+// where the name and the value of a header line are in the raw response
+typedef struct {
+    size_t name;
+    size_t name_size;
+    size_t value;
+    size_t value_size;
+} response_header;
+
+typedef struct response response;
+
+// gets the body of a response piece by piece, as it arrives
+typedef void (*response_body_callback)(response *response, const char *data, size_t size,
+                                       void *context);
+
+/* a response that is received incrementally, one read() at a time; header
+ * lines are parsed once as they arrive and chunked bodies are decoded on the
+ * fly, so raw always holds the header block followed by the plain body
+ * (unless the body is streamed to on_body instead)
+ */
+struct response {
+    buffer raw;
+    int state;
+    size_t line_start;
+    size_t header_end;
+    size_t total;
+    int keep_alive;
+    int status_code;
+    size_t reason;
+    size_t reason_size;
+    response_header *headers;
+    int header_count;
+    int header_capacity;
+    int chunk_state;
+    size_t chunk_left;
+    size_t chunk_digits;
+    size_t body_size;
+    int streaming;
+    response_body_callback on_body;
+    void *body_context;
+};
+
+// initializes an empty response
+void response_init(response *response);
+
+// destroys a response and the data received so far
+void response_destroy(response *response);
+
+// empties a response so that it can be received again, keeping where its body goes
+void response_reset(response *response);
+
+/* makes the body of a successful response go to on_body as it arrives
+ * instead of being kept; the body of any other status is kept as usual
+ */
+void response_stream_body(response *response, response_body_callback on_body, void *context);
+
+/* adds received data to a response and returns how many bytes were part of
+ * it, the rest belongs to whatever the server sent after this response
+ */
+size_t response_feed(response *response, const char *data, size_t size);
+
+// tells the response that the server closed the connection, returns 0 if it was cut short
+int response_finish(response *response);
+
+// checks if the whole response has been received
+int response_is_complete(response *response);
+
+// checks if the server sent something that can't be framed as a response
+int response_is_invalid(response *response);
+
+/* returns the value of the first header called name (in any case) and puts
+ * its size in value_size, NULL if the response doesn't have it
+ * NOTE: the value isn't NUL-terminated
+ */
+const char *response_header_value(response *response, const char *name, size_t *value_size);
+
+/* like response_header_value, but starts looking at the header at *index and
+ * leaves *index after the one found, so that headers sent several times (like
+ * Set-Cookie) can all be gone through by starting from 0
+ */
+const char *response_next_header_value(response *response, const char *name, int *index,
+                                       size_t *value_size);
+
+// checks if a response has a 2xx status code
+int response_is_success(response *response);
+
+/* returns the body of a complete response and puts its size in body_size,
+ * unless that's NULL
+ * NOTE: the body is NUL-terminated once the response is detached
+ */
+char *response_body(response *response, size_t *body_size);
+
+/* moves a complete response to the heap and empties the original
+ * NOTE: the caller is responsible for freeing it with response_free
+ */
+response *response_detach(response *response);
+
+// frees a response returned by response_detach
+void response_free(response *response);
+
+#endif
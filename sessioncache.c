@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sessioncache.h"
+#include "helpers.h"
+
+/* the start of a session cache file, followed by cookie_count cookies (a
+ * session_cache_cookie, then its name and value) and the token_size bytes of
+ * the token
+ */
+typedef struct {
+    char magic[SESSION_CACHE_MAGIC_SIZE];
+    uint32_t cookie_count;
+    uint32_t token_size;
+    char host[HOST_MAX_LEN];
+} session_cache_header;
+
+typedef struct {
+    int64_t expires;
+    uint32_t name_size;
+    uint32_t value_size;
+} session_cache_cookie;
+
+// returns the size of the file that keeps the cookies of jar and a token of token_size
+static size_t session_cache_size(cookie_jar *jar, size_t token_size)
+{
+    size_t size = sizeof(session_cache_header) + token_size;
+
+    for (int i = 0; i < jar->count; i++) {
+        size += sizeof(session_cache_cookie) + strlen(jar->cookies[i].name)
+                + strlen(jar->cookies[i].value);
+    }
+
+    return size;
+}
+
+int session_cache_load(const char *path, const char *host, cookie_jar *jar, char **auth_token)
+{
+    struct stat st;
+    session_cache_header header;
+    time_t now = time(NULL);
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+
+    if (fd < 0)
+        return 0;
+
+    // a session others could read or replace isn't trusted
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_uid != getuid()
+        || (st.st_mode & (S_IRWXG | S_IRWXO)) != 0
+        || (size_t) st.st_size < sizeof(header) || st.st_size > SESSION_CACHE_MAX_SIZE) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = st.st_size;
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.magic, SESSION_CACHE_MAGIC, SESSION_CACHE_MAGIC_SIZE) != 0
+        || strncmp(header.host, host, sizeof(header.host)) != 0) {
+        munmap(data, size);
+        return 0;
+    }
+
+    // every size is checked against what's left, the file may have been cut short
+    size_t offset = sizeof(header);
+    cookie_jar loaded;
+
+    cookie_jar_init(&loaded);
+
+    for (uint32_t i = 0; i < header.cookie_count; i++) {
+        session_cache_cookie cookie;
+
+        if (size - offset < sizeof(cookie))
+            break;
+
+        memcpy(&cookie, data + offset, sizeof(cookie));
+        offset += sizeof(cookie);
+
+        if (size - offset < (size_t) cookie.name_size + cookie.value_size || cookie.name_size == 0)
+            break;
+
+        cookie_jar_put(&loaded, data + offset, cookie.name_size,
+                       data + offset + cookie.name_size, cookie.value_size, cookie.expires, now);
+        offset += cookie.name_size + cookie.value_size;
+    }
+
+    if (offset + header.token_size != size || loaded.count == 0) {
+        cookie_jar_destroy(&loaded);
+        munmap(data, size);
+        return 0;
+    }
+
+    *auth_token = NULL;
+    if (header.token_size > 0) {
+        *auth_token = calloc(header.token_size + 1, sizeof(char));
+        if (*auth_token == NULL) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+
+        memcpy(*auth_token, data + offset, header.token_size);
+    }
+
+    munmap(data, size);
+    cookie_jar_destroy(jar);
+    *jar = loaded;
+
+    return 1;
+}
+
+int session_cache_save(const char *path, const char *host, cookie_jar *jar,
+                       const char *auth_token)
+{
+    session_cache_header header = { 0 };
+    size_t token_size = auth_token != NULL ? strlen(auth_token) : 0;
+    size_t size = session_cache_size(jar, token_size);
+    size_t temp_size = strlen(path) + sizeof(".tmp");
+    char *temp = malloc(temp_size);
+
+    if (temp == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    if (size > SESSION_CACHE_MAX_SIZE || strlen(host) >= sizeof(header.host)) {
+        free(temp);
+        return -1;
+    }
+
+    // written next to the old one and renamed over it, so a reader never sees half of it
+    snprintf(temp, temp_size, "%s.tmp", path);
+    unlink(temp);
+
+    int fd = open(temp, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        free(temp);
+        return -1;
+    }
+
+    char *data = MAP_FAILED;
+
+    if (fchmod(fd, S_IRUSR | S_IWUSR) == 0 && ftruncate(fd, size) == 0)
+        data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (data == MAP_FAILED) {
+        close(fd);
+        unlink(temp);
+        free(temp);
+        return -1;
+    }
+
+    memcpy(header.magic, SESSION_CACHE_MAGIC, SESSION_CACHE_MAGIC_SIZE);
+    header.cookie_count = jar->count;
+    header.token_size = token_size;
+    strcpy(header.host, host);
+    memcpy(data, &header, sizeof(header));
+
+    size_t offset = sizeof(header);
+
+    for (int i = 0; i < jar->count; i++) {
+        session_cache_cookie cookie = {
+            jar->cookies[i].expires, strlen(jar->cookies[i].name), strlen(jar->cookies[i].value)
+        };
+
+        memcpy(data + offset, &cookie, sizeof(cookie));
+        offset += sizeof(cookie);
+        memcpy(data + offset, jar->cookies[i].name, cookie.name_size);
+        offset += cookie.name_size;
+        memcpy(data + offset, jar->cookies[i].value, cookie.value_size);
+        offset += cookie.value_size;
+    }
+
+    if (token_size > 0)
+        memcpy(data + offset, auth_token, token_size);
+
+    int result = msync(data, size, MS_SYNC);
+
+    munmap(data, size);
+    close(fd);
+
+    if (result == 0)
+        result = rename(temp, path);
+
+    if (result < 0)
+        unlink(temp);
+
+    free(temp);
+
+    return result;
+}
+
+void session_cache_remove(const char *path)
+{
+    unlink(path);
+}
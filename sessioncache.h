@@ -0,0 +1,34 @@
+#ifndef _SESSIONCACHE_
+#define _SESSIONCACHE_
+
+#include "cookiejar.h"
+
+// set to the path of a file that keeps the session between runs of the client
+#define SESSION_CACHE_ENV "SESSION_CACHE"
+
+// marks a session cache file, the digit changes with its layout
+#define SESSION_CACHE_MAGIC "PCSESS01"
+#define SESSION_CACHE_MAGIC_SIZE 8
+
+// anything bigger than this isn't a session cache written by the client
+#define SESSION_CACHE_MAX_SIZE (1 << 20)
+
+/* loads the cookies and the token saved for host at path into jar and
+ * *auth_token, returns 0 if there is no usable session there: a missing or
+ * corrupt file, one saved for another host, or one that other users could
+ * read; the session isn't checked with the server, so a request refused with
+ * it is what shows it's no longer valid
+ * NOTE: the caller is responsible for freeing *auth_token
+ */
+int session_cache_load(const char *path, const char *host, cookie_jar *jar, char **auth_token);
+
+/* saves the cookies of jar and auth_token (which can be NULL) for host at
+ * path, in a file only the user can read, returns -1 if it can't
+ */
+int session_cache_save(const char *path, const char *host, cookie_jar *jar,
+                       const char *auth_token);
+
+// removes the session saved at path
+void session_cache_remove(const char *path);
+
+#endif
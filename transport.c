@@ -0,0 +1,1307 @@
+#include <stdlib.h>     /* exit, atoi, malloc, free */
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>     /* read, write, close */
+#include <string.h>     /* memcpy, memset */
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h> /* socket, connect */
+#include <sys/epoll.h>
+#include <poll.h>
+#include <time.h>
+#include "helpers.h"
+#include "transport.h"
+#include "resolver.h"
+
+/* io_uring operations, kept in the low bits of the connection pointer in
+ * user_data, which is 0 for the timer that starts delayed connect attempts
+ */
+#define URING_CONNECT 1
+#define URING_SEND 2
+#define URING_RECV 3
+#define URING_OP_MASK 3
+
+// sets up the io_uring backend, returns -1 if the kernel can't run it
+static int uring_backend_init(transport *transport)
+{
+    static const int ops[] = { IORING_OP_POLL_ADD, IORING_OP_TIMEOUT, IORING_OP_SENDMSG,
+                               IORING_OP_READ_FIXED, IORING_OP_RECV };
+    struct iovec iov[TRANSPORT_URING_BUFFERS];
+
+    if (uring_init(&transport->ring, TRANSPORT_URING_ENTRIES, ops, sizeof(ops) / sizeof(ops[0])) < 0)
+        return -1;
+
+    // receive buffers are registered once so that reads don't have to map them every time
+    transport->buffers = calloc(TRANSPORT_URING_BUFFERS, TRANSPORT_BUFFER_SIZE);
+    if (transport->buffers == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < TRANSPORT_URING_BUFFERS; i++) {
+        iov[i].iov_base = transport->buffers + i * TRANSPORT_BUFFER_SIZE;
+        iov[i].iov_len = TRANSPORT_BUFFER_SIZE;
+        transport->free_buffers[i] = i;
+    }
+
+    transport->free_count = TRANSPORT_URING_BUFFERS;
+
+    if (uring_register_buffers(&transport->ring, iov, TRANSPORT_URING_BUFFERS) < 0) {
+        uring_destroy(&transport->ring);
+        free(transport->buffers);
+        transport->buffers = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+int transport_init(transport *transport)
+{
+    char *backend = getenv(TRANSPORT_BACKEND_ENV);
+
+    transport->active = 0;
+    transport->connections = NULL;
+    transport->buffers = NULL;
+    transport->epollfd = -1;
+    transport->timer_inflight = 0;
+    transport->timer_at = 0;
+
+    if ((backend == NULL || strcmp(backend, "epoll") != 0) && uring_backend_init(transport) == 0) {
+        transport->backend = TRANSPORT_URING;
+        return 0;
+    }
+
+    transport->backend = TRANSPORT_EPOLL;
+    transport->epollfd = epoll_create1(EPOLL_CLOEXEC);
+
+    return transport->epollfd < 0 ? -1 : 0;
+}
+
+// unlinks a connection from the engine and frees it
+static void connection_free(transport *transport, connection *conn)
+{
+    connection **link = &transport->connections;
+
+    while (*link != conn)
+        link = &(*link)->next;
+
+    *link = conn->next;
+    free(conn->spare_buffer);
+    free(conn->transfers);
+    free(conn);
+}
+
+/* returns how far the transfer at index got on a connection: the ones behind
+ * the one being written haven't been sent at all, and the ones before it are
+ * waiting for their responses
+ */
+static int connection_transfer_phase(connection *conn, int index)
+{
+    transfer *transfer = conn->transfers[index];
+
+    if (conn->state == CONNECTION_CONNECTING)
+        return TRANSFER_PHASE_CONNECT;
+
+    if (index >= conn->sending)
+        return TRANSFER_PHASE_SEND;
+
+    return transfer->response.raw.size == 0 ? TRANSFER_PHASE_FIRST_BYTE : TRANSFER_PHASE_BODY;
+}
+
+/* marks the transfers a connection hasn't finished yet as failed, each in
+ * the phase it got to, so that the ones that never went out can be told apart
+ */
+static void connection_fail_transfers(transport *transport, connection *conn)
+{
+    for (int i = conn->receiving; i < conn->count; i++) {
+        conn->transfers[i]->state = TRANSFER_FAILED;
+        conn->transfers[i]->phase = connection_transfer_phase(conn, i);
+    }
+
+    transport->active -= conn->count - conn->receiving;
+}
+
+void transport_destroy(transport *transport)
+{
+    while (transport->connections != NULL) {
+        connection *conn = transport->connections;
+
+        if (conn->state != CONNECTION_CLOSING)
+            connection_fail_transfers(transport, conn);
+
+        race_abort(&conn->race);
+        if (conn->sockfd >= 0)
+            close_connection(conn->sockfd);
+        connection_free(transport, conn);
+    }
+
+    if (transport->backend == TRANSPORT_URING) {
+        // the kernel cancels whatever was still in flight when the ring goes away
+        uring_destroy(&transport->ring);
+        free(transport->buffers);
+    } else {
+        close(transport->epollfd);
+    }
+
+    transport->active = 0;
+}
+
+void transfer_init_iov(transfer *transfer, char *host_ip, int portno,
+                       const struct iovec *iov, int iovcnt)
+{
+    transfer->host_ip = host_ip;
+    transfer->portno = portno;
+    transfer->iovcnt = iovcnt;
+    transfer->length = 0;
+    transfer->state = TRANSFER_QUEUED;
+    transfer->phase = TRANSFER_PHASE_CONNECT;
+    memset(&transfer->budget, 0, sizeof(transfer->budget));
+    response_init(&transfer->response);
+
+    for (int i = 0; i < iovcnt; i++) {
+        transfer->iov[i] = iov[i];
+        transfer->length += iov[i].iov_len;
+    }
+}
+
+void transfer_init(transfer *transfer, char *host_ip, int portno, const char *message)
+{
+    struct iovec iov = { (void *) message, strlen(message) };
+
+    transfer_init_iov(transfer, host_ip, portno, &iov, 1);
+}
+
+/* gathers the unsent pieces of the queued requests, starting sent bytes into
+ * the first one, and returns how many were added to iov
+ */
+static int connection_gather(connection *conn, struct iovec *iov)
+{
+    int iovcnt = 0;
+    size_t skip = conn->sent;
+
+    for (int i = conn->sending; i < conn->count; i++) {
+        transfer *transfer = conn->transfers[i];
+
+        for (int j = 0; j < transfer->iovcnt; j++) {
+            if (iovcnt == TRANSPORT_MAX_IOV)
+                return iovcnt;
+
+            if (skip >= transfer->iov[j].iov_len) {
+                skip -= transfer->iov[j].iov_len;
+                continue;
+            }
+
+            iov[iovcnt].iov_base = (char *) transfer->iov[j].iov_base + skip;
+            iov[iovcnt].iov_len = transfer->iov[j].iov_len - skip;
+            iovcnt++;
+            skip = 0;
+        }
+    }
+
+    return iovcnt;
+}
+
+// adds an io_uring operation for a connection to the submission queue
+static struct io_uring_sqe *uring_prepare(transport *transport, connection *conn, int op)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(&transport->ring);
+    if (sqe == NULL)
+        error("ERROR submitting to io_uring");
+
+    sqe->fd = conn->sockfd;
+    sqe->user_data = (uint64_t) (uintptr_t) conn | op;
+
+    return sqe;
+}
+
+// queues the io_uring operations a connection needs in its current state
+static void uring_arm(transport *transport, connection *conn)
+{
+    struct io_uring_sqe *sqe;
+
+    // connects are non-blocking so that they can race, io_uring polls for them to finish
+    if (conn->state == CONNECTION_CONNECTING) {
+        for (; conn->race_watched < conn->race.started; conn->race_watched++) {
+            if (conn->race.sockfds[conn->race_watched] < 0)
+                continue;
+
+            sqe = uring_prepare(transport, conn, URING_CONNECT);
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = conn->race.sockfds[conn->race_watched];
+            sqe->poll32_events = POLLOUT;
+            conn->connect_inflight++;
+        }
+    }
+
+    if (conn->state == CONNECTION_SENDING && !conn->send_inflight) {
+        memset(&conn->msg, 0, sizeof(conn->msg));
+        conn->msg.msg_iov = conn->iov;
+        conn->msg.msg_iovlen = connection_gather(conn, conn->iov);
+
+        sqe = uring_prepare(transport, conn, URING_SEND);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t) (uintptr_t) &conn->msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        conn->send_inflight = 1;
+    }
+
+    // while sending, responses to the first requests may already be coming back
+    if ((conn->state == CONNECTION_SENDING || conn->state == CONNECTION_RECEIVING)
+        && !conn->recv_inflight) {
+        sqe = uring_prepare(transport, conn, URING_RECV);
+
+        if (transport->free_count > 0) {
+            conn->buffer = transport->free_buffers[--transport->free_count];
+            sqe->opcode = IORING_OP_READ_FIXED;
+            sqe->addr = (uint64_t) (uintptr_t) (transport->buffers + conn->buffer * TRANSPORT_BUFFER_SIZE);
+            sqe->buf_index = conn->buffer;
+        } else {
+            // more connections than registered buffers, so this one reads into its own
+            if (conn->spare_buffer == NULL)
+                conn->spare_buffer = malloc(TRANSPORT_BUFFER_SIZE);
+
+            if (conn->spare_buffer == NULL) {
+                perror("malloc");
+                exit(EXIT_FAILURE);
+            }
+
+            sqe->opcode = IORING_OP_RECV;
+            sqe->addr = (uint64_t) (uintptr_t) conn->spare_buffer;
+        }
+
+        sqe->len = TRANSPORT_BUFFER_SIZE;
+        conn->recv_inflight = 1;
+    }
+}
+
+// tells the backend what a connection is waiting for in its current state
+static int connection_arm(transport *transport, connection *conn)
+{
+    if (transport->backend == TRANSPORT_URING) {
+        uring_arm(transport, conn);
+        return 0;
+    }
+
+    struct epoll_event event = { .data.ptr = conn };
+
+    if (conn->state == CONNECTION_CONNECTING) {
+        event.events = EPOLLOUT;
+
+        for (; conn->race_watched < conn->race.started; conn->race_watched++) {
+            int sockfd = conn->race.sockfds[conn->race_watched];
+
+            if (sockfd >= 0 && epoll_ctl(transport->epollfd, EPOLL_CTL_ADD, sockfd, &event) < 0)
+                return -1;
+        }
+
+        return 0;
+    }
+
+    if (conn->state == CONNECTION_SENDING)
+        event.events = EPOLLOUT | EPOLLIN;
+    else
+        event.events = EPOLLIN;
+
+    int op = conn->watched ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+    conn->watched = 1;
+    return epoll_ctl(transport->epollfd, op, conn->sockfd, &event);
+}
+
+/* starts the clock on the phase a connection is waiting for whenever it
+ * changes, with the budget of the transfer that phase belongs to
+ */
+static void connection_track(connection *conn)
+{
+    transfer *transfer;
+    int phase;
+    int budget;
+
+    if (conn->state == CONNECTION_CLOSING)
+        return;
+
+    if (conn->state == CONNECTION_CONNECTING) {
+        transfer = conn->transfers[conn->receiving];
+        phase = TRANSFER_PHASE_CONNECT;
+    } else if (conn->state == CONNECTION_SENDING) {
+        transfer = conn->transfers[conn->sending];
+        phase = TRANSFER_PHASE_SEND;
+    } else {
+        transfer = conn->transfers[conn->receiving];
+        phase = transfer->response.raw.size == 0 ? TRANSFER_PHASE_FIRST_BYTE
+                                                  : TRANSFER_PHASE_BODY;
+    }
+
+    if (transfer == conn->tracked && phase == conn->phase)
+        return;
+
+    if (phase == TRANSFER_PHASE_CONNECT)
+        budget = transfer->budget.connect;
+    else if (phase == TRANSFER_PHASE_SEND)
+        budget = transfer->budget.send;
+    else if (phase == TRANSFER_PHASE_FIRST_BYTE)
+        budget = transfer->budget.first_byte;
+    else
+        budget = transfer->budget.body;
+
+    conn->tracked = transfer;
+    conn->phase = phase;
+    conn->deadline = budget > 0 ? clock_ms() + budget : 0;
+}
+
+// gets a socket for some transfers, from the idle pool unless fresh is set
+static int connection_open(transport *transport, transfer **transfers, int count, int fresh)
+{
+    transfer *first = transfers[0];
+
+    if (strlen(first->host_ip) >= HOST_MAX_LEN)
+        return -1;
+
+    connection *conn = calloc(1, sizeof(connection));
+    if (conn == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    conn->transfers = calloc(count, sizeof(transfer *));
+    if (conn->transfers == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(conn->transfers, transfers, count * sizeof(transfer *));
+    conn->count = count;
+    conn->buffer = -1;
+    conn->portno = first->portno;
+    strcpy(conn->host_ip, first->host_ip);
+
+    conn->sockfd = fresh ? -1 : pool_acquire(first->host_ip, first->portno);
+    conn->reused = conn->sockfd >= 0;
+    conn->state = conn->reused ? CONNECTION_SENDING : CONNECTION_CONNECTING;
+
+    int started = 1;
+
+    // a connect started ahead of time that hasn't gone through yet races the other addresses
+    if (conn->reused && connection_is_connecting(conn->sockfd)) {
+        started = race_adopt(&conn->race, conn->sockfd, first->host_ip, first->portno) == 0;
+        if (!started)
+            close_connection(conn->sockfd);
+
+        conn->sockfd = -1;
+        conn->reused = 0;
+        conn->state = CONNECTION_CONNECTING;
+    } else if (!conn->reused) {
+        started = race_start(&conn->race, first->host_ip, first->portno, AF_UNSPEC,
+                             SOCK_STREAM | SOCK_CLOEXEC, 0) == 0;
+    }
+
+    if (!started) {
+        free(conn->transfers);
+        free(conn);
+        return -1;
+    }
+
+    // io_uring waits for blocking sockets by itself, it gives up on non-blocking ones
+    if (transport->backend == TRANSPORT_URING && conn->reused)
+        fcntl(conn->sockfd, F_SETFL, fcntl(conn->sockfd, F_GETFL) & ~O_NONBLOCK);
+
+    for (int i = 0; i < count; i++) {
+        response_reset(&transfers[i]->response);
+        transfers[i]->state = TRANSFER_ACTIVE;
+    }
+
+    conn->next = transport->connections;
+    transport->connections = conn;
+
+    if (connection_arm(transport, conn) < 0) {
+        race_abort(&conn->race);
+        close_connection(conn->sockfd);
+        connection_free(transport, conn);
+        return -1;
+    }
+
+    connection_track(conn);
+
+    return 0;
+}
+
+void transport_submit_pipelined(transport *transport, transfer **transfers, int count)
+{
+    if (count == 0)
+        return;
+
+    if (connection_open(transport, transfers, count, 0) < 0) {
+        for (int i = 0; i < count; i++)
+            transfers[i]->state = TRANSFER_FAILED;
+
+        return;
+    }
+
+    transport->active += count;
+}
+
+void transport_submit(transport *transport, transfer *transfer)
+{
+    transport_submit_pipelined(transport, &transfer, 1);
+}
+
+// frees a closing connection once the backend doesn't use it anymore
+static void connection_finish(transport *transport, connection *conn)
+{
+    if (conn->connect_inflight || conn->send_inflight || conn->recv_inflight)
+        return;
+
+    if (transport->backend == TRANSPORT_EPOLL && conn->watched)
+        epoll_ctl(transport->epollfd, EPOLL_CTL_DEL, conn->sockfd, NULL);
+
+    if (conn->sockfd >= 0)
+        pool_release(conn->sockfd, conn->host_ip, conn->portno, conn->reusable);
+    connection_free(transport, conn);
+}
+
+/* stops using a connection, whose transfers can go away right after this;
+ * io_uring operations still in flight have to complete before the socket
+ * can be closed or reused
+ */
+static void connection_close(transport *transport, connection *conn, int reusable)
+{
+    conn->state = CONNECTION_CLOSING;
+    conn->reusable = reusable;
+    race_abort(&conn->race);
+
+    if (!reusable && (conn->connect_inflight || conn->send_inflight || conn->recv_inflight))
+        shutdown(conn->sockfd, SHUT_RDWR);
+
+    connection_finish(transport, conn);
+}
+
+// returns whether a request uses a method that can safely run more than once
+static int request_is_idempotent(const char *request)
+{
+    static const char *methods[] = { "GET ", "HEAD ", "PUT ", "DELETE ", "OPTIONS " };
+
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+        if (strncmp(request, methods[i], strlen(methods[i])) == 0)
+            return 1;
+
+    return 0;
+}
+
+/* returns whether the transfer at index can go again on another connection:
+ * a request that wasn't written at all never got to the server, any other
+ * may already have been acted upon, so only an idempotent one can, unless
+ * every method is allowed to be retried
+ */
+static int connection_transfer_resendable(connection *conn, int index)
+{
+    if (index > conn->sending || (index == conn->sending && conn->sent == 0))
+        return 1;
+
+    return request_is_idempotent(conn->transfers[index]->iov[0].iov_base)
+           || getenv(RETRY_ALL_METHODS_ENV) != NULL;
+}
+
+/* gives up on a connection, sending the requests that weren't answered yet
+ * again on a fresh one when it's safe to do so, and failing the others so
+ * that the caller decides whether to retry them
+ */
+static void connection_fail(transport *transport, connection *conn)
+{
+    int remaining = conn->count - conn->receiving;
+    transfer **transfers = conn->transfers + conn->receiving;
+
+    // the server couldn't be reached at all, its address may have changed
+    if (conn->state == CONNECTION_CONNECTING)
+        resolver_forget(conn->host_ip, conn->portno);
+
+    /* a pooled connection may have been closed by the server right before we
+     * used it and a server may close a pipelined connection after any response,
+     * but a body that was partly streamed to its consumer can't be taken back
+     */
+    if (remaining > 0 && (conn->receiving > 0
+                          || (conn->reused && transfers[0]->response.raw.size == 0))
+        && !(transfers[0]->response.streaming && transfers[0]->response.body_size > 0)) {
+        transfer **resent = calloc(remaining, sizeof(transfer *));
+        int count = 0;
+
+        if (resent == NULL) {
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = conn->receiving; i < conn->count; i++)
+            if (connection_transfer_resendable(conn, i))
+                resent[count++] = conn->transfers[i];
+
+        if (count > 0 && connection_open(transport, resent, count, 1) == 0) {
+            for (int i = conn->receiving; i < conn->count; i++) {
+                if (!connection_transfer_resendable(conn, i)) {
+                    conn->transfers[i]->state = TRANSFER_FAILED;
+                    conn->transfers[i]->phase = connection_transfer_phase(conn, i);
+                    transport->active--;
+                }
+            }
+
+            free(resent);
+            connection_close(transport, conn, 0);
+            return;
+        }
+
+        free(resent);
+    }
+
+    connection_fail_transfers(transport, conn);
+    connection_close(transport, conn, 0);
+}
+
+/* moves the send position of a connection forward, across request
+ * boundaries, and returns -1 if the connection had to be given up
+ */
+static int connection_sent(transport *transport, connection *conn, size_t bytes)
+{
+    while (conn->sending < conn->count) {
+        size_t left = conn->transfers[conn->sending]->length - conn->sent;
+
+        if (bytes < left) {
+            conn->sent += bytes;
+            break;
+        }
+
+        bytes -= left;
+        conn->sending++;
+        conn->sent = 0;
+    }
+
+    // every request is out, only wait for the responses
+    if (conn->sending == conn->count)
+        conn->state = CONNECTION_RECEIVING;
+
+    connection_track(conn);
+
+    // epoll keeps watching the same events until the state changes
+    if (transport->backend == TRANSPORT_EPOLL && conn->state == CONNECTION_SENDING)
+        return 0;
+
+    if (connection_arm(transport, conn) < 0) {
+        connection_fail(transport, conn);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* splits received data between the responses of the connection's transfers,
+ * returns 1 once it can't carry any more responses, 0 if more data is needed
+ * and -1 if the server sent something that isn't a valid response
+ */
+static int connection_dispatch(transport *transport, connection *conn,
+                               const char *data, size_t size, int *reusable)
+{
+    size_t offset = 0;
+
+    while (offset < size) {
+        transfer *transfer = conn->transfers[conn->receiving];
+
+        offset += response_feed(&transfer->response, data + offset, size - offset);
+
+        if (response_is_invalid(&transfer->response))
+            return -1;
+
+        if (!response_is_complete(&transfer->response))
+            return 0;
+
+        transfer->state = TRANSFER_DONE;
+        transport->active--;
+        conn->receiving++;
+
+        if (!transfer->response.keep_alive)
+            return 1;
+
+        if (conn->receiving == conn->count) {
+            // the server sent more than we asked for, so the connection can't be trusted anymore
+            *reusable = offset == size;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* handles data received on a connection, size being 0 when the server closed
+ * it, and returns 1 if the connection is done with
+ */
+static int connection_received(transport *transport, connection *conn, const char *data, size_t size)
+{
+    int reusable = 0;
+    int result;
+
+    if (size > 0) {
+        result = connection_dispatch(transport, conn, data, size, &reusable);
+    } else {
+        transfer *transfer = conn->transfers[conn->receiving];
+
+        result = response_finish(&transfer->response) ? 1 : -1;
+
+        if (result > 0) {
+            transfer->state = TRANSFER_DONE;
+            transport->active--;
+            conn->receiving++;
+        }
+    }
+
+    if (result < 0 || (result > 0 && conn->receiving < conn->count))
+        connection_fail(transport, conn);
+    else if (result > 0)
+        connection_close(transport, conn, reusable);
+    else
+        connection_track(conn);
+
+    return result != 0;
+}
+
+/* moves the connect race of a connection forward, returns 1 once the
+ * connection can send and 0 otherwise, including when it had to be given up
+ */
+static int connection_connect(transport *transport, connection *conn)
+{
+    int sockfd = race_poll(&conn->race);
+
+    if (sockfd == RACE_FAILED) {
+        connection_fail(transport, conn);
+        return 0;
+    }
+
+    if (sockfd != RACE_PENDING) {
+        conn->sockfd = sockfd;
+        conn->state = CONNECTION_SENDING;
+        connection_track(conn);
+
+        // epoll already watches the winning socket since it was an attempt
+        if (transport->backend == TRANSPORT_URING)
+            fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) & ~O_NONBLOCK);
+        else
+            conn->watched = 1;
+    }
+
+    // this also watches the attempts that were just started
+    if (connection_arm(transport, conn) < 0) {
+        connection_fail(transport, conn);
+        return 0;
+    }
+
+    return conn->state == CONNECTION_SENDING;
+}
+
+// advances the state machine of a connection after an epoll event
+static void epoll_handle(transport *transport, connection *conn)
+{
+    char data[TRANSPORT_BUFFER_SIZE];
+
+    if (conn->state == CONNECTION_CONNECTING && !connection_connect(transport, conn))
+        return;
+
+    /* sockets can come from the pool in any mode, so every call is explicitly
+     * non-blocking
+     */
+    while (conn->state == CONNECTION_SENDING) {
+        struct iovec iov[TRANSPORT_MAX_IOV];
+        struct msghdr msg = { .msg_iov = iov };
+
+        msg.msg_iovlen = connection_gather(conn, iov);
+
+        ssize_t bytes = sendmsg(conn->sockfd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (bytes < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            connection_fail(transport, conn);
+            return;
+        }
+
+        if (connection_sent(transport, conn, (size_t) bytes) < 0)
+            return;
+    }
+
+    while (1) {
+        ssize_t bytes = recv(conn->sockfd, data, TRANSPORT_BUFFER_SIZE, MSG_DONTWAIT);
+
+        if (bytes < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                connection_fail(transport, conn);
+
+            return;
+        }
+
+        if (connection_received(transport, conn, data, (size_t) bytes))
+            return;
+    }
+}
+
+// advances the state machine of a connection after an io_uring completion
+static void uring_handle(transport *transport, struct io_uring_cqe *cqe)
+{
+    connection *conn = (connection *) (uintptr_t) (cqe->user_data & ~(uint64_t) URING_OP_MASK);
+    int op = cqe->user_data & URING_OP_MASK;
+    int res = cqe->res;
+    int buffer = -1;
+
+    if (op == URING_CONNECT) {
+        conn->connect_inflight--;
+    } else if (op == URING_SEND) {
+        conn->send_inflight = 0;
+    } else {
+        conn->recv_inflight = 0;
+        buffer = conn->buffer;
+        conn->buffer = -1;
+    }
+
+    if (conn->state == CONNECTION_CLOSING) {
+        connection_finish(transport, conn);
+    } else if (op == URING_CONNECT) {
+        // polls on losing attempts still complete after the race was won
+        if (conn->state == CONNECTION_CONNECTING)
+            connection_connect(transport, conn);
+    } else if (res == -EAGAIN || res == -EINTR) {
+        if (connection_arm(transport, conn) < 0)
+            connection_fail(transport, conn);
+    } else if (res < 0) {
+        connection_fail(transport, conn);
+    } else if (op == URING_SEND) {
+        connection_sent(transport, conn, (size_t) res);
+    } else {
+        char *data = buffer >= 0 ? transport->buffers + buffer * TRANSPORT_BUFFER_SIZE
+                                 : conn->spare_buffer;
+
+        int done = connection_received(transport, conn, data, (size_t) res);
+
+        // the data was copied into the response by now, so the next read can reuse the buffer
+        if (buffer >= 0)
+            transport->free_buffers[transport->free_count++] = buffer;
+
+        buffer = -1;
+
+        if (!done && connection_arm(transport, conn) < 0)
+            connection_fail(transport, conn);
+    }
+
+    if (buffer >= 0)
+        transport->free_buffers[transport->free_count++] = buffer;
+}
+
+// gives up on a connection whose current phase ran out of time
+static void connection_timeout(transport *transport, connection *conn)
+{
+    for (int i = conn->receiving; i < conn->count; i++) {
+        conn->transfers[i]->state = TRANSFER_TIMEOUT;
+        conn->transfers[i]->phase = connection_transfer_phase(conn, i);
+    }
+
+    transport->active -= conn->count - conn->receiving;
+    connection_close(transport, conn, 0);
+}
+
+/* returns the milliseconds until a connect attempt or a deadline is due, -1
+ * if there is nothing to wait for
+ */
+static int transport_timeout(transport *transport)
+{
+    long long now = clock_ms();
+    int timeout = -1;
+
+    for (connection *conn = transport->connections; conn != NULL; conn = conn->next) {
+        if (conn->state == CONNECTION_CLOSING)
+            continue;
+
+        int left = conn->state == CONNECTION_CONNECTING ? race_timeout(&conn->race) : -1;
+
+        if (conn->deadline != 0 && (left < 0 || conn->deadline - now < left))
+            left = conn->deadline > now ? (int) (conn->deadline - now) : 0;
+
+        if (left >= 0 && (timeout < 0 || left < timeout))
+            timeout = left;
+    }
+
+    return timeout;
+}
+
+// times out the connections past their deadline and starts the connect attempts that are due
+static void transport_expire(transport *transport)
+{
+    long long now = clock_ms();
+    connection *conn = transport->connections;
+
+    while (conn != NULL) {
+        connection *next = conn->next;
+
+        if (conn->state != CONNECTION_CLOSING && conn->deadline != 0 && now >= conn->deadline)
+            connection_timeout(transport, conn);
+        else if (conn->state == CONNECTION_CONNECTING && race_timeout(&conn->race) == 0)
+            connection_connect(transport, conn);
+
+        conn = next;
+    }
+}
+
+/* queues an io_uring timeout for when the engine has to wake up, which also
+ * completes as soon as anything else does, so that it can be armed again
+ * with what's due next
+ * NOTE: a timer in flight can't be moved closer, so an earlier one is added
+ */
+static void uring_arm_timer(transport *transport, int timeout)
+{
+    long long now = clock_ms();
+
+    if (timeout < 0 || (transport->timer_inflight > 0 && transport->timer_at != 0
+                        && transport->timer_at <= now + timeout))
+        return;
+
+    struct io_uring_sqe *sqe = uring_get_sqe(&transport->ring);
+    if (sqe == NULL)
+        error("ERROR submitting to io_uring");
+
+    transport->timer.tv_sec = timeout / 1000;
+    transport->timer.tv_nsec = (timeout % 1000) * 1000000LL;
+
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t) (uintptr_t) &transport->timer;
+    sqe->len = 1;
+    sqe->off = 1;
+    sqe->user_data = 0;
+    transport->timer_inflight++;
+    transport->timer_at = now + timeout;
+}
+
+void transport_step(transport *transport, int timeout)
+{
+    struct epoll_event events[TRANSPORT_MAX_EVENTS];
+    int due = transport_timeout(transport);
+
+    if (due >= 0 && (timeout < 0 || due < timeout))
+        timeout = due;
+
+    if (transport->backend == TRANSPORT_URING) {
+        struct io_uring_cqe *cqe;
+
+        uring_arm_timer(transport, timeout);
+
+        // everything queued since the last round goes to the kernel with a single call
+        if (uring_submit(&transport->ring, 1) < 0)
+            error("ERROR waiting for io_uring completions");
+
+        while ((cqe = uring_peek_cqe(&transport->ring)) != NULL) {
+            struct io_uring_cqe completion = *cqe;
+
+            uring_cqe_seen(&transport->ring);
+
+            // which timer went off isn't known, so the next step arms a new one if needed
+            if (completion.user_data == 0) {
+                transport->timer_inflight--;
+                transport->timer_at = 0;
+            } else {
+                uring_handle(transport, &completion);
+            }
+        }
+
+        transport_expire(transport);
+        return;
+    }
+
+    int n = epoll_wait(transport->epollfd, events, TRANSPORT_MAX_EVENTS, timeout);
+
+    if (n < 0) {
+        if (errno == EINTR)
+            return;
+
+        error("ERROR waiting for socket events");
+    }
+
+    for (int i = 0; i < n; i++) {
+        int seen = 0;
+
+        /* the connect attempts of a connection all point to it, handling
+         * it once covers all of them and it may be gone afterwards
+         */
+        for (int j = 0; j < i && !seen; j++)
+            seen = events[j].data.ptr == events[i].data.ptr;
+
+        if (!seen)
+            epoll_handle(transport, events[i].data.ptr);
+    }
+
+    transport_expire(transport);
+}
+
+void transport_run(transport *transport)
+{
+    /* connections given up on may still have io_uring operations pointing
+     * at request data, so they have to be gone before the caller frees it
+     */
+    while (transport->active > 0 || transport->connections != NULL)
+        transport_step(transport, -1);
+}
+
+void transport_cancel(transport *transport, transfer *transfer)
+{
+    for (connection *conn = transport->connections; conn != NULL; conn = conn->next) {
+        if (conn->state == CONNECTION_CLOSING)
+            continue;
+
+        for (int i = conn->receiving; i < conn->count; i++) {
+            if (conn->transfers[i] != transfer)
+                continue;
+
+            for (int j = conn->receiving; j < conn->count; j++)
+                conn->transfers[j]->state = TRANSFER_CANCELLED;
+
+            transport->active -= conn->count - conn->receiving;
+            connection_close(transport, conn, 0);
+            return;
+        }
+    }
+}
+
+void latency_record(latency_history *history, int ms)
+{
+    history->samples[history->next] = ms;
+    history->next = (history->next + 1) % LATENCY_SAMPLES;
+
+    if (history->count < LATENCY_SAMPLES)
+        history->count++;
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+int latency_percentile(const latency_history *history, int percentile, int fallback)
+{
+    int sorted[LATENCY_SAMPLES];
+
+    if (history->count < LATENCY_MIN_SAMPLES)
+        return fallback;
+
+    memcpy(sorted, history->samples, history->count * sizeof(int));
+    qsort(sorted, history->count, sizeof(int), compare_ints);
+
+    return sorted[(history->count - 1) * percentile / 100];
+}
+
+// returns the engine shared by the blocking request helpers
+static transport *default_transport(void)
+{
+    static transport engine;
+    static int engine_ready;
+
+    if (!engine_ready) {
+        if (transport_init(&engine) < 0)
+            error("ERROR creating transport engine");
+
+        engine_ready = 1;
+    }
+
+    return &engine;
+}
+
+const char *request_status_message(const request_status *status)
+{
+    static const char *timeouts[] = {
+        "Timed out connecting to the server",
+        "Timed out sending the request",
+        "Timed out waiting for the response",
+        "Timed out receiving the response",
+    };
+
+    if (status->state == TRANSFER_TIMEOUT)
+        return timeouts[status->phase];
+
+    if (status->state == TRANSFER_FAILED)
+        return "Couldn't exchange messages with the server";
+
+    if (status->state == TRANSFER_CANCELLED)
+        return "The request was cancelled";
+
+    return "OK";
+}
+
+/* decides whether a request should be sent again after the given attempt,
+ * paying for the retry from a budget shared by the whole process that
+ * successful requests fill back up, so that retries can't pile onto an
+ * outage
+ */
+static int retry_wanted(const char *request, const request_status *status,
+                        response *received, int attempt)
+{
+    // counted in tenths of a retry, every successful request earns one back
+    static int tokens = RETRY_BUDGET * 10;
+    static int max_attempts;
+
+    if (max_attempts == 0) {
+        char *value = getenv(RETRY_ATTEMPTS_ENV);
+        max_attempts = value != NULL && atoi(value) > 0 ? atoi(value) : RETRY_ATTEMPTS;
+    }
+
+    int server_error = received != NULL && received->status_code >= 500;
+
+    if (status->state == TRANSFER_DONE && !server_error) {
+        if (tokens < RETRY_BUDGET * 10)
+            tokens++;
+
+        return 0;
+    }
+
+    if (status->state == TRANSFER_CANCELLED || attempt >= max_attempts || tokens < 10)
+        return 0;
+
+    // a request that never got to the server can always go again
+    int unsent = status->state != TRANSFER_DONE && status->phase == TRANSFER_PHASE_CONNECT;
+
+    if (!unsent && !request_is_idempotent(request) && getenv(RETRY_ALL_METHODS_ENV) == NULL)
+        return 0;
+
+    tokens -= 10;
+    return 1;
+}
+
+/* waits before the next attempt, a random time up to a limit that doubles
+ * with every attempt, so that clients retrying together spread out
+ */
+static void retry_backoff(int attempt)
+{
+    static int seeded;
+
+    if (!seeded) {
+        srandom(time(NULL) ^ getpid());
+        seeded = 1;
+    }
+
+    long limit = RETRY_BASE_DELAY;
+    for (int i = 1; i < attempt && limit < RETRY_MAX_DELAY; i++)
+        limit *= 2;
+
+    if (limit > RETRY_MAX_DELAY)
+        limit = RETRY_MAX_DELAY;
+
+    long delay = random() % (limit + 1);
+    struct timespec ts = { delay / 1000, (delay % 1000) * 1000000L };
+
+    nanosleep(&ts, NULL);
+}
+
+// sends a request until it gets a response or retrying it isn't wanted anymore
+static response *request_attempts(char *host_ip, int portno, const struct iovec *iov, int iovcnt,
+                                  const request_budget *budget, request_status *status,
+                                  response_body_callback on_body, void *context)
+{
+    transfer transfer;
+    response *received;
+
+    // retries send the same request pieces again
+    for (int attempt = 1; ; attempt++) {
+        transfer_init_iov(&transfer, host_ip, portno, iov, iovcnt);
+        transfer.budget = *budget;
+        response_stream_body(&transfer.response, on_body, context);
+        transport_submit(default_transport(), &transfer);
+        transport_run(default_transport());
+
+        status->state = transfer.state;
+        status->phase = transfer.phase;
+
+        // a body that was partly handed over can't be taken back
+        int streamed = transfer.response.streaming && transfer.response.body_size > 0;
+
+        if (transfer.state == TRANSFER_DONE) {
+            received = response_detach(&transfer.response);
+        } else {
+            response_destroy(&transfer.response);
+            received = NULL;
+        }
+
+        if ((received == NULL && streamed) || !retry_wanted(iov[0].iov_base, status, received, attempt))
+            return received;
+
+        response_free(received);
+        retry_backoff(attempt);
+    }
+}
+
+response *make_request(char *host_ip, int portno, char *message,
+                       const request_budget *budget, request_status *status)
+{
+    struct iovec iov = { message, strlen(message) };
+
+    return request_attempts(host_ip, portno, &iov, 1, budget, status, NULL, NULL);
+}
+
+response *make_request_iov(char *host_ip, int portno, const struct iovec *iov, int iovcnt,
+                           const request_budget *budget, request_status *status)
+{
+    return request_attempts(host_ip, portno, iov, iovcnt, budget, status, NULL, NULL);
+}
+
+response *make_streamed_request(char *host_ip, int portno, char *message,
+                                const request_budget *budget, request_status *status,
+                                response_body_callback on_body, void *context)
+{
+    struct iovec iov = { message, strlen(message) };
+
+    return request_attempts(host_ip, portno, &iov, 1, budget, status, on_body, context);
+}
+
+// returns whether every request of a hedged batch got its answer or can't get one anymore
+static int hedge_settled(transfer *primaries, transfer *backups, int count)
+{
+    for (int i = 0; i < count; i++) {
+        if (primaries[i].state == TRANSFER_DONE || backups[i].state == TRANSFER_DONE)
+            continue;
+
+        if (primaries[i].state == TRANSFER_ACTIVE || backups[i].state == TRANSFER_ACTIVE)
+            return 0;
+    }
+
+    return 1;
+}
+
+// makes one attempt at a batch of hedged requests
+static response **hedged_attempt(char *host_ip, int portno, char **messages, int count,
+                                 const request_budget *budget, request_status *statuses, int delay)
+{
+    transport *engine = default_transport();
+    transfer *primaries = calloc(count, sizeof(transfer));
+    transfer *backups = calloc(count, sizeof(transfer));
+    transfer **pipeline = calloc(count, sizeof(transfer *));
+    response **responses = calloc(count, sizeof(response *));
+    if (primaries == NULL || backups == NULL || pipeline == NULL || responses == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        transfer_init(&primaries[i], host_ip, portno, messages[i]);
+        primaries[i].budget = *budget;
+        pipeline[i] = &primaries[i];
+    }
+
+    transport_submit_pipelined(engine, pipeline, count);
+
+    if (delay >= 0) {
+        long long hedge_at = clock_ms() + delay;
+        int hedged = 0;
+
+        while (engine->active > 0 && clock_ms() < hedge_at)
+            transport_step(engine, (int) (hedge_at - clock_ms()));
+
+        // the requests still waiting for an answer go out again on a second connection
+        for (int i = 0; i < count; i++) {
+            if (primaries[i].state != TRANSFER_ACTIVE)
+                continue;
+
+            transfer_init(&backups[i], host_ip, portno, messages[i]);
+            backups[i].budget = *budget;
+            pipeline[hedged++] = &backups[i];
+        }
+
+        transport_submit_pipelined(engine, pipeline, hedged);
+
+        while (!hedge_settled(primaries, backups, count))
+            transport_step(engine, -1);
+
+        // whichever copy lost the race isn't needed anymore
+        for (int i = 0; i < count; i++) {
+            if (primaries[i].state == TRANSFER_ACTIVE)
+                transport_cancel(engine, &primaries[i]);
+
+            if (backups[i].state == TRANSFER_ACTIVE)
+                transport_cancel(engine, &backups[i]);
+        }
+    }
+
+    transport_run(engine);
+
+    for (int i = 0; i < count; i++) {
+        transfer *winner = backups[i].state == TRANSFER_DONE ? &backups[i] : &primaries[i];
+
+        statuses[i].state = winner->state;
+        statuses[i].phase = winner->phase;
+        responses[i] = winner->state == TRANSFER_DONE ? response_detach(&winner->response) : NULL;
+
+        response_destroy(&primaries[i].response);
+        response_destroy(&backups[i].response);
+    }
+
+    free(pipeline);
+    free(primaries);
+    free(backups);
+
+    return responses;
+}
+
+response **make_hedged_requests(char *host_ip, int portno, char **messages, int count,
+                                const request_budget *budget, request_status *statuses, int delay)
+{
+    response **responses = hedged_attempt(host_ip, portno, messages, count, budget, statuses, delay);
+    char **retry_messages = calloc(count, sizeof(char *));
+    request_status *retry_statuses = calloc(count, sizeof(request_status));
+    int *pending = calloc(count, sizeof(int));
+    if (retry_messages == NULL || retry_statuses == NULL || pending == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+
+    int pending_n = count;
+    for (int i = 0; i < count; i++)
+        pending[i] = i;
+
+    // only the requests of the last attempt are looked at, the others are settled
+    for (int attempt = 1; ; attempt++) {
+        int retry_n = 0;
+
+        for (int j = 0; j < pending_n; j++) {
+            int i = pending[j];
+
+            if (retry_wanted(messages[i], &statuses[i], responses[i], attempt)) {
+                pending[retry_n] = i;
+                retry_messages[retry_n++] = messages[i];
+            }
+        }
+
+        if (retry_n == 0)
+            break;
+
+        retry_backoff(attempt);
+
+        response **retried = hedged_attempt(host_ip, portno, retry_messages, retry_n, budget,
+                                        retry_statuses, delay);
+
+        for (int j = 0; j < retry_n; j++) {
+            response_free(responses[pending[j]]);
+            responses[pending[j]] = retried[j];
+            statuses[pending[j]] = retry_statuses[j];
+        }
+
+        free(retried);
+        pending_n = retry_n;
+    }
+
+    free(retry_messages);
+    free(retry_statuses);
+    free(pending);
+
+    return responses;
+}
+
+response **make_pipelined_requests(char *host_ip, int portno, char **messages, int count,
+                                   const request_budget *budget, request_status *statuses)
+{
+    return make_hedged_requests(host_ip, portno, messages, count, budget, statuses, -1);
+}
@@ -0,0 +1,239 @@
+#ifndef _TRANSPORT_
+#define _TRANSPORT_
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "helpers.h"
+#include "response.h"
+#include "uring.h"
+
+#define TRANSPORT_MAX_EVENTS 64
+#define TRANSPORT_MAX_IOV 64
+#define TRANSFER_MAX_IOV 4
+#define TRANSPORT_BUFFER_SIZE 16384
+#define TRANSPORT_URING_ENTRIES 256
+#define TRANSPORT_URING_BUFFERS 64
+#define LATENCY_SAMPLES 64
+#define LATENCY_MIN_SAMPLES 5
+
+// set to "epoll" to use the epoll backend even when io_uring is available
+#define TRANSPORT_BACKEND_ENV "TRANSPORT_BACKEND"
+
+/* requests that fail, time out or get a 5xx response are attempted up to
+ * RETRY_ATTEMPTS times, with a random backoff of at most RETRY_BASE_DELAY
+ * milliseconds doubling up to RETRY_MAX_DELAY, while the process has retries
+ * left out of RETRY_BUDGET, which every ten successful requests add one to
+ */
+#define RETRY_ATTEMPTS 3
+#define RETRY_BASE_DELAY 100
+#define RETRY_MAX_DELAY 2000
+#define RETRY_BUDGET 10
+#define RETRY_ATTEMPTS_ENV "RETRY_ATTEMPTS"
+
+// set to retry every request, not only the ones with idempotent methods
+#define RETRY_ALL_METHODS_ENV "RETRY_ALL_METHODS"
+
+// backends that drive the sockets of a transport engine
+#define TRANSPORT_EPOLL 0
+#define TRANSPORT_URING 1
+
+// states of a transfer
+#define TRANSFER_QUEUED 0
+#define TRANSFER_ACTIVE 1
+#define TRANSFER_DONE 2
+#define TRANSFER_FAILED 3
+#define TRANSFER_TIMEOUT 4
+#define TRANSFER_CANCELLED 5
+
+// phases of a transfer, each one with its own time budget
+#define TRANSFER_PHASE_CONNECT 0
+#define TRANSFER_PHASE_SEND 1
+#define TRANSFER_PHASE_FIRST_BYTE 2
+#define TRANSFER_PHASE_BODY 3
+
+// states of a connection
+#define CONNECTION_CONNECTING 0
+#define CONNECTION_SENDING 1
+#define CONNECTION_RECEIVING 2
+#define CONNECTION_CLOSING 3
+
+// how long each phase of a transfer may take, in milliseconds, 0 meaning no limit
+typedef struct {
+    int connect;
+    int send;
+    int first_byte;
+    int body;
+} request_budget;
+
+// how a request ended, phase being the one that ran out of time for TRANSFER_TIMEOUT
+typedef struct {
+    int state;
+    int phase;
+} request_status;
+
+/* a request sent to a server and the response it gets back, the request can
+ * be made of several pieces that are written together with a single sendmsg
+ */
+typedef struct {
+    char *host_ip;
+    int portno;
+    struct iovec iov[TRANSFER_MAX_IOV];
+    int iovcnt;
+    size_t length;
+    int state;
+    int phase;
+    request_budget budget;
+    response response;
+} transfer;
+
+/* a socket carrying one or more pipelined transfers, whose requests are
+ * written back to back and whose responses come back in order
+ */
+typedef struct connection {
+    int sockfd;
+    int state;
+    int reused;
+    int reusable;
+    char host_ip[HOST_MAX_LEN];
+    int portno;
+    transfer **transfers;
+    int count;
+    int sending;
+    int receiving;
+    size_t sent;
+    int watched;
+
+    // connects racing to the server's addresses, and how many of them the backend watches
+    connect_race race;
+    int race_watched;
+
+    // the phase of the transfer being waited on and when it runs out of time (0 for never)
+    transfer *tracked;
+    int phase;
+    long long deadline;
+
+    // io_uring operations in flight (a poll for each connect attempt) and the data they point to
+    int connect_inflight;
+    int send_inflight;
+    int recv_inflight;
+    int buffer;
+    char *spare_buffer;
+    struct iovec iov[TRANSPORT_MAX_IOV];
+    struct msghdr msg;
+
+    struct connection *next;
+} connection;
+
+// an event loop that runs many transfers at once from a single thread
+typedef struct {
+    int backend;
+    int epollfd;
+    uring ring;
+    char *buffers;
+    int free_buffers[TRANSPORT_URING_BUFFERS];
+    int free_count;
+    struct __kernel_timespec timer;
+    int timer_inflight;
+    long long timer_at;
+    int active;
+    connection *connections;
+} transport;
+
+/* initializes a transport engine on top of io_uring when the kernel has it,
+ * falling back to epoll otherwise, returns -1 on failure
+ */
+int transport_init(transport *transport);
+
+// closes every connection of a transport engine
+void transport_destroy(transport *transport);
+
+/* prepares a transfer of a request message to host_ip:portno, without time
+ * limits until its budget is set
+ */
+void transfer_init(transfer *transfer, char *host_ip, int portno, const char *message);
+
+// prepares a transfer of a request made of at most TRANSFER_MAX_IOV pieces
+void transfer_init_iov(transfer *transfer, char *host_ip, int portno,
+                       const struct iovec *iov, int iovcnt);
+
+// starts a transfer, its state tells when it's done
+void transport_submit(transport *transport, transfer *transfer);
+
+/* starts several transfers to the same server pipelined on a single
+ * connection, only meant for idempotent requests since unanswered ones
+ * are sent again if the server closes the connection midway
+ */
+void transport_submit_pipelined(transport *transport, transfer **transfers, int count);
+
+/* waits at most timeout milliseconds (forever for -1) for something to
+ * happen and moves the transfers it concerns forward
+ */
+void transport_step(transport *transport, int timeout);
+
+// runs the event loop until every submitted transfer is done or has failed
+void transport_run(transport *transport);
+
+/* gives up on a transfer along with the ones pipelined behind it on the same
+ * connection, which end up TRANSFER_CANCELLED
+ */
+void transport_cancel(transport *transport, transfer *transfer);
+
+// the most recent response times of a kind of request, in milliseconds
+typedef struct {
+    int samples[LATENCY_SAMPLES];
+    int count;
+    int next;
+} latency_history;
+
+// adds a response time to a history, replacing the oldest one when it's full
+void latency_record(latency_history *history, int ms);
+
+/* returns the given percentile of the response times in a history, or
+ * fallback while it has fewer than LATENCY_MIN_SAMPLES of them
+ */
+int latency_percentile(const latency_history *history, int percentile, int fallback);
+
+// describes how a request that didn't get a response ended
+const char *request_status_message(const request_status *status);
+
+/* sends a request over a kept-alive connection within budget and returns the
+ * response, or NULL if it failed or timed out, which status tells apart
+ * NOTE: idempotent requests that fail are retried, like the ones below
+ * NOTE: the caller is responsible for freeing the response with response_free
+ */
+response *make_request(char *host_ip, int portno, char *message,
+                       const request_budget *budget, request_status *status);
+
+// sends a request made of several pieces, like make_request
+response *make_request_iov(char *host_ip, int portno, const struct iovec *iov, int iovcnt,
+                           const request_budget *budget, request_status *status);
+
+/* sends a request like make_request, but hands the body of a successful
+ * response to on_body as it arrives instead of keeping it, so that it can be
+ * processed without ever being whole in memory
+ * NOTE: a request whose body was partly handed over isn't retried
+ */
+response *make_streamed_request(char *host_ip, int portno, char *message,
+                                const request_budget *budget, request_status *status,
+                                response_body_callback on_body, void *context);
+
+/* sends several requests pipelined over a kept-alive connection and returns
+ * their responses in the same order, NULL for the ones that failed or timed
+ * out, with their outcome in statuses
+ * NOTE: the caller is responsible for freeing the returned array and responses
+ * (with response_free)
+ */
+response **make_pipelined_requests(char *host_ip, int portno, char **messages, int count,
+                                   const request_budget *budget, request_status *statuses);
+
+/* makes pipelined requests like make_pipelined_requests, but the ones that
+ * haven't been answered after delay milliseconds are sent again on another
+ * connection and the first answer of the two is used, -1 meaning no hedging
+ * NOTE: only meant for requests without side effects, which can run twice
+ */
+response **make_hedged_requests(char *host_ip, int portno, char **messages, int count,
+                                const request_budget *budget, request_status *statuses, int delay);
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "uring.h"
+
+#define load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// checks that the kernel knows about every operation the caller needs
+static int uring_supports(uring *ring, const int *ops, int ops_count)
+{
+    size_t size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    int supported = 1;
+
+    if (probe == NULL)
+        return 0;
+
+    if (syscall(__NR_io_uring_register, ring->ringfd, IORING_REGISTER_PROBE,
+                probe, IORING_OP_LAST) < 0) {
+        free(probe);
+        return 0;
+    }
+
+    for (int i = 0; i < ops_count; i++) {
+        if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            supported = 0;
+    }
+
+    free(probe);
+
+    return supported;
+}
+
+int uring_init(uring *ring, unsigned entries, const int *ops, int ops_count)
+{
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(uring));
+    memset(&params, 0, sizeof(params));
+
+    ring->ringfd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->ringfd < 0)
+        return -1;
+
+    // older kernels without these features aren't worth supporting
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)
+        || !uring_supports(ring, ops, ops_count)) {
+        close(ring->ringfd);
+        return -1;
+    }
+
+    ring->entries = params.sq_entries;
+    ring->rings_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    if (params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe) > ring->rings_size)
+        ring->rings_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // both rings live in the same mapping
+    ring->rings = mmap(NULL, ring->rings_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring->ringfd, IORING_OFF_SQ_RING);
+    if (ring->rings == MAP_FAILED) {
+        close(ring->ringfd);
+        return -1;
+    }
+
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ringfd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->rings, ring->rings_size);
+        close(ring->ringfd);
+        return -1;
+    }
+
+    char *sq = ring->rings;
+    char *cq = ring->rings;
+
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+void uring_destroy(uring *ring)
+{
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->rings, ring->rings_size);
+    close(ring->ringfd);
+}
+
+struct io_uring_sqe *uring_get_sqe(uring *ring)
+{
+    unsigned head = load_acquire(ring->sq_head);
+    unsigned tail = *ring->sq_tail + ring->queued;
+
+    if (tail - head == ring->entries) {
+        uring_submit(ring, 0);
+        head = load_acquire(ring->sq_head);
+        tail = *ring->sq_tail + ring->queued;
+
+        if (tail - head == ring->entries)
+            return NULL;
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+    ring->queued++;
+
+    return sqe;
+}
+
+int uring_submit(uring *ring, unsigned wait_nr)
+{
+    unsigned flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    unsigned submitted = ring->queued;
+
+    // publish every entry filled in since the last submission at once
+    store_release(ring->sq_tail, *ring->sq_tail + ring->queued);
+    ring->queued = 0;
+
+    while (1) {
+        int ret = syscall(__NR_io_uring_enter, ring->ringfd, submitted, wait_nr, flags, NULL, 0);
+
+        if (ret >= 0 || errno != EINTR)
+            return ret;
+
+        // the entries were already consumed, only the wait is left to retry
+        submitted = 0;
+    }
+}
+
+struct io_uring_cqe *uring_peek_cqe(uring *ring)
+{
+    unsigned head = *ring->cq_head;
+
+    if (head == load_acquire(ring->cq_tail))
+        return NULL;
+
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(uring *ring)
+{
+    store_release(ring->cq_head, *ring->cq_head + 1);
+}
+
+int uring_register_buffers(uring *ring, struct iovec *iov, unsigned count)
+{
+    return syscall(__NR_io_uring_register, ring->ringfd, IORING_REGISTER_BUFFERS, iov, count);
+}
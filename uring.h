@@ -0,0 +1,54 @@
+#ifndef _URING_
+#define _URING_
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* a minimal io_uring made straight from the system calls, so that it works
+ * without liburing being installed
+ */
+typedef struct {
+    int ringfd;
+    unsigned entries;
+    unsigned queued;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *rings;
+    size_t rings_size;
+    size_t sqes_size;
+} uring;
+
+/* sets up a ring with room for entries submissions, returns -1 if io_uring
+ * isn't available or doesn't support the operations in ops
+ */
+int uring_init(uring *ring, unsigned entries, const int *ops, int ops_count);
+
+// unmaps and closes a ring
+void uring_destroy(uring *ring);
+
+/* returns a cleared submission entry to fill in, submitting the queued ones
+ * first if the submission queue is full
+ */
+struct io_uring_sqe *uring_get_sqe(uring *ring);
+
+// submits the queued entries and waits for at least wait_nr completions
+int uring_submit(uring *ring, unsigned wait_nr);
+
+// returns the next completion or NULL if there is none yet
+struct io_uring_cqe *uring_peek_cqe(uring *ring);
+
+// marks the completion returned by uring_peek_cqe as consumed
+void uring_cqe_seen(uring *ring);
+
+// registers buffers that fixed reads can then use without mapping them every time
+int uring_register_buffers(uring *ring, struct iovec *iov, unsigned count);
+
+#endif